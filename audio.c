@@ -82,3 +82,19 @@ void audio_stop(int channel) {
                 Mix_FadeOutChannel(channel, 0);
         }
 }
+
+static void mixer_play(void* ctx, audio_sound sound) { audio_play(sound); }
+
+static int mixer_loop(void* ctx, audio_sound sound) {
+        return audio_loop(sound);
+}
+
+static void mixer_stop(void* ctx, int channel) { audio_stop(channel); }
+
+audio_sink audio_mixer_sink() {
+        return (audio_sink){
+            .play = mixer_play,
+            .loop = mixer_loop,
+            .stop = mixer_stop,
+        };
+}
@@ -14,10 +14,20 @@ typedef enum {
         NUM_SOUNDS
 } audio_sound;
 
+// Where the machine sends its sound events. A zeroed sink is silent, which
+// is what headless runs use.
+typedef struct {
+        void* ctx;
+        void (*play)(void* ctx, audio_sound sound);
+        int (*loop)(void* ctx, audio_sound sound);
+        void (*stop)(void* ctx, int channel);
+} audio_sink;
+
 int audio_init();
 void audio_quit();
 void audio_play(audio_sound sound);
 int audio_loop(audio_sound sound);
 void audio_stop(int channel);
+audio_sink audio_mixer_sink();
 
 #endif
@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "boot.h"
+#include "hash.h"
+#include "machine.h"
+#include "rom.h"
+#include "script.h"
+#include "state.h"
+
+// Runs a list of headless jobs on a pool of worker threads. Each line of
+// the jobs file is
+//
+//     <rom> <frames> [<script>|-] [<output>|-]
+//
+// where <output>, if given, receives the video RAM after the last frame.
+// Jobs are dealt round-robin onto per-worker deques; a worker pops from the
+// back of its own deque and, once that is empty, steals from the front of
+// the others'. Each worker allocates its machine on its own core and reuses
+// it for every job it runs. Given a BOOT_CACHE directory, jobs start from
+// the ROM's post-boot snapshot (see boot.h) instead of power-on.
+
+#define PATH_LEN 256
+
+typedef struct {
+        char rom_path[PATH_LEN];
+        char script_path[PATH_LEN];
+        char output[PATH_LEN];
+        size_t frames;
+        rom* r;
+        uint8_t* boot;
+
+        uint64_t hash;
+        size_t frames_run;
+        int ran;
+        int err;
+} job;
+
+typedef struct {
+        pthread_t thread;
+        pthread_mutex_t lock;
+        size_t id;
+        size_t* queue;
+        size_t head;
+        size_t tail;
+        size_t stolen;
+} worker;
+
+static job* jobs;
+static size_t njobs;
+static worker* workers;
+static size_t nworkers;
+
+static int pop(worker* w, size_t* j) {
+        int found = 0;
+        pthread_mutex_lock(&w->lock);
+        if (w->head < w->tail) {
+                *j = w->queue[--w->tail];
+                found = 1;
+        }
+        pthread_mutex_unlock(&w->lock);
+        return found;
+}
+
+static int steal(worker* thief, size_t* j) {
+        for (size_t i = 1; i < nworkers; ++i) {
+                worker* victim = &workers[(thief->id + i) % nworkers];
+                int found = 0;
+                pthread_mutex_lock(&victim->lock);
+                if (victim->head < victim->tail) {
+                        *j = victim->queue[victim->head++];
+                        found = 1;
+                }
+                pthread_mutex_unlock(&victim->lock);
+                if (found) {
+                        ++thief->stolen;
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+static void pin(size_t id) {
+#ifdef __linux__
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpus <= 0) {
+                return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(id % ncpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static void run_job(job* jb, machine* m) {
+        jb->ran = 1;
+        script* s = 0;
+        if (jb->script_path[0]) {
+                s = script_load(jb->script_path);
+                if (!s) {
+                        jb->err = 1;
+                        return;
+                }
+        }
+
+        machine_init(m, jb->r, (audio_sink){0});
+        if (jb->boot && state_load(m, jb->boot, STATE_SIZE)) {
+                jb->err = 1;
+                script_delete(s);
+                return;
+        }
+
+        input_source input = s ? script_source(s) : (input_source){0};
+        jb->hash = HASH_INIT;
+        for (size_t frame = 0; frame < jb->frames; ++frame) {
+                if (input.poll && input.poll(input.ctx, &m->pts)) {
+                        break;
+                }
+                machine_run(m, machine_frame_cycles(m));
+                jb->hash =
+                    hash_bytes(jb->hash, machine_vram(m), MACHINE_VRAM_SIZE);
+                ++jb->frames_run;
+        }
+
+        if (jb->output[0]) {
+                FILE* f = fopen(jb->output, "wb");
+                if (!f || fwrite(machine_vram(m), MACHINE_VRAM_SIZE, 1, f) !=
+                              1) {
+                        fprintf(stderr, "Failed to write output: %s\n",
+                                jb->output);
+                        jb->err = 1;
+                }
+                if (f) {
+                        fclose(f);
+                }
+        }
+
+        script_delete(s);
+}
+
+static void* worker_main(void* arg) {
+        worker* w = arg;
+        pin(w->id);
+
+        // one machine per worker, reinitialized in place for every job
+        machine* m = machine_new(0, (audio_sink){0});
+        if (!m) {
+                return 0;
+        }
+
+        size_t j = 0;
+        while (pop(w, &j) || steal(w, &j)) {
+                run_job(&jobs[j], m);
+        }
+
+        machine_delete(m);
+        return 0;
+}
+
+static int load_jobs(char const* path, char const* boot_dir) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+                fprintf(stderr, "Failed to open jobs file: %s\n", path);
+                return 1;
+        }
+
+        size_t cap = 0;
+        size_t lineno = 0;
+        char line[4 * PATH_LEN] = "";
+        while (fgets(line, sizeof(line), f)) {
+                ++lineno;
+                char rom_path[PATH_LEN] = "";
+                char script_path[PATH_LEN] = "-";
+                char output[PATH_LEN] = "-";
+                unsigned long frames = 0;
+                int n = sscanf(line, "%255s %lu %255s %255s", rom_path,
+                               &frames, script_path, output);
+                if (n <= 0 || rom_path[0] == '#') {
+                        continue;
+                }
+                if (n < 2) {
+                        fprintf(stderr,
+                                "%s:%zu: expected <rom> <frames> [<script>] "
+                                "[<output>]\n",
+                                path, lineno);
+                        fclose(f);
+                        return 1;
+                }
+
+                if (njobs == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        job* grown = realloc(jobs, cap * sizeof(job));
+                        if (!grown) {
+                                fclose(f);
+                                return 1;
+                        }
+                        jobs = grown;
+                }
+
+                job* jb = &jobs[njobs++];
+                *jb = (job){.frames = frames};
+                strcpy(jb->rom_path, rom_path);
+                if (strcmp(script_path, "-")) {
+                        strcpy(jb->script_path, script_path);
+                }
+                if (strcmp(output, "-")) {
+                        strcpy(jb->output, output);
+                }
+        }
+        fclose(f);
+
+        // every ROM is read, and booted, once and shared by all jobs that
+        // name it
+        for (size_t i = 0; i < njobs; ++i) {
+                for (size_t k = 0; k < i && !jobs[i].r; ++k) {
+                        if (!strcmp(jobs[k].rom_path, jobs[i].rom_path)) {
+                                jobs[i].r = jobs[k].r;
+                                jobs[i].boot = jobs[k].boot;
+                        }
+                }
+                if (jobs[i].r) {
+                        continue;
+                }
+                jobs[i].r = rom_open(jobs[i].rom_path);
+                if (!jobs[i].r) {
+                        return 1;
+                }
+                if (boot_dir) {
+                        jobs[i].boot = malloc(STATE_SIZE);
+                        if (!jobs[i].boot ||
+                            boot_snapshot(jobs[i].r, boot_dir, jobs[i].boot)) {
+                                return 1;
+                        }
+                }
+        }
+
+        return 0;
+}
+
+static void free_jobs() {
+        for (size_t i = 0; i < njobs; ++i) {
+                int shared = 0;
+                for (size_t k = 0; k < i; ++k) {
+                        shared |= jobs[k].r == jobs[i].r;
+                }
+                if (!shared) {
+                        rom_close(jobs[i].r);
+                        free(jobs[i].boot);
+                }
+        }
+        free(jobs);
+}
+
+static double now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[static argc + 1]) {
+        if (argc < 2) {
+                fprintf(stderr, "usage: %s JOBS [WORKERS] [BOOT_CACHE]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        nworkers = argc > 2 ? strtoul(argv[2], 0, 0) : 0;
+        if (!nworkers) {
+                long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+                nworkers = ncpus > 0 ? ncpus : 1;
+        }
+
+        if (load_jobs(argv[1], argc > 3 ? argv[3] : 0)) {
+                free_jobs();
+                return EXIT_FAILURE;
+        }
+        if (nworkers > njobs && njobs) {
+                nworkers = njobs;
+        }
+
+        workers = calloc(nworkers, sizeof(worker));
+        size_t* queues = calloc(njobs + 1, sizeof(size_t));
+        if (!workers || !queues) {
+                fprintf(stderr, "Failed to allocate workers\n");
+                free_jobs();
+                return EXIT_FAILURE;
+        }
+
+        // deal jobs round-robin, each worker owns a contiguous queue slice
+        size_t offset = 0;
+        for (size_t i = 0; i < nworkers; ++i) {
+                worker* w = &workers[i];
+                w->id = i;
+                w->queue = queues + offset;
+                for (size_t j = i; j < njobs; j += nworkers) {
+                        w->queue[w->tail++] = j;
+                }
+                offset += w->tail;
+                pthread_mutex_init(&w->lock, 0);
+        }
+
+        double start = now();
+        size_t spawned = 0;
+        for (; spawned < nworkers; ++spawned) {
+                if (pthread_create(&workers[spawned].thread, 0, worker_main,
+                                   &workers[spawned])) {
+                        fprintf(stderr, "Failed to start worker %zu\n",
+                                spawned);
+                        break;
+                }
+        }
+        // the queues of workers that could not be started are run here,
+        // alongside the threads that could
+        for (size_t i = spawned; i < nworkers; ++i) {
+                worker_main(&workers[i]);
+        }
+        size_t stolen = 0;
+        for (size_t i = 0; i < nworkers; ++i) {
+                if (i < spawned) {
+                        pthread_join(workers[i].thread, 0);
+                }
+                pthread_mutex_destroy(&workers[i].lock);
+                stolen += workers[i].stolen;
+        }
+        double elapsed = now() - start;
+
+        int failed = 0;
+        size_t frames = 0;
+        for (size_t i = 0; i < njobs; ++i) {
+                job* jb = &jobs[i];
+                // left over when no worker got a machine to run it on
+                jb->err |= !jb->ran;
+                frames += jb->frames_run;
+                failed |= jb->err;
+                printf("%s %zu %016llx%s\n", jb->rom_path, jb->frames_run,
+                       (unsigned long long)jb->hash, jb->err ? " FAILED" : "");
+        }
+        printf(
+            "%zu jobs, %zu frames in %.3fs on %zu workers (%.0f frames/s, "
+            "%zu stolen)\n",
+            njobs, frames, elapsed, nworkers,
+            elapsed > 0 ? frames / elapsed : 0.0, stolen);
+
+        free(queues);
+        free(workers);
+        free_jobs();
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "boot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "machine.h"
+#include "rom.h"
+#include "state.h"
+
+typedef struct {
+        uint8_t magic[4];  // "SIBT"
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t rom_hash;
+        uint32_t frames;
+        uint32_t reserved2;
+        uint64_t state_hash;
+} boot_header;
+
+static void cache_path(char* path, size_t size, char const* dir,
+                       uint64_t hash) {
+        snprintf(path, size, "%s/%016llx.boot", dir, (unsigned long long)hash);
+}
+
+static int load_cached(char const* path, uint64_t hash,
+                       uint8_t state[STATE_SIZE]) {
+        FILE* f = fopen(path, "rb");
+        if (!f) {
+                return 1;
+        }
+        boot_header h;
+        int err = fread(&h, sizeof(h), 1, f) != 1 ||
+                  fread(state, STATE_SIZE, 1, f) != 1;
+        fclose(f);
+
+        if (err || memcmp(h.magic, "SIBT", 4) || h.version != BOOT_VERSION ||
+            h.rom_hash != hash || h.frames != BOOT_FRAMES ||
+            h.state_hash != hash_bytes(HASH_INIT, state, STATE_SIZE)) {
+                fprintf(stderr, "Ignoring stale or corrupt boot snapshot: %s\n",
+                        path);
+                return 1;
+        }
+        return 0;
+}
+
+// Writes through a temporary file of its own so that concurrent readers
+// never see a partial snapshot and concurrent writers never share one.
+static void store_cached(char const* path, uint64_t hash,
+                         uint8_t const state[STATE_SIZE]) {
+        boot_header h = {
+            .magic = {'S', 'I', 'B', 'T'},
+            .version = BOOT_VERSION,
+            .rom_hash = hash,
+            .frames = BOOT_FRAMES,
+            .state_hash = hash_bytes(HASH_INIT, state, STATE_SIZE),
+        };
+
+        char tmp[4096];
+        snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+        int fd = mkstemp(tmp);
+        if (fd >= 0) {
+                // mkstemp makes it private; snapshots are meant to be shared
+                fchmod(fd, 0644);
+        }
+        FILE* f = fd < 0 ? 0 : fdopen(fd, "wb");
+        if (!f) {
+                fprintf(stderr, "Failed to write boot snapshot: %s\n", tmp);
+                if (fd >= 0) {
+                        close(fd);
+                        remove(tmp);
+                }
+                return;
+        }
+        int err = fwrite(&h, sizeof(h), 1, f) != 1 ||
+                  fwrite(state, STATE_SIZE, 1, f) != 1;
+        if (fclose(f) || err || rename(tmp, path)) {
+                fprintf(stderr, "Failed to write boot snapshot: %s\n", path);
+                remove(tmp);
+        }
+}
+
+// Fills state with the post-boot state of r, from dir if it holds a valid
+// snapshot, otherwise by booting a machine and then caching the result in
+// dir. dir may be null to skip the cache.
+int boot_snapshot(rom const* r, char const* dir, uint8_t state[STATE_SIZE]) {
+        uint64_t hash = rom_hash(r);
+        char path[4096] = "";
+        if (dir) {
+                cache_path(path, sizeof(path), dir, hash);
+                if (!load_cached(path, hash, state)) {
+                        return 0;
+                }
+        }
+
+        machine* m = machine_new(r, (audio_sink){0});
+        if (!m) {
+                return 1;
+        }
+        for (size_t i = 0; i < BOOT_FRAMES; ++i) {
+                machine_run(m, machine_frame_cycles(m));
+        }
+        state_save(m, state);
+        machine_delete(m);
+
+        if (dir) {
+                store_cached(path, hash, state);
+        }
+        return 0;
+}
+
+// Brings m, which must run r, to the post-boot state.
+int boot_machine(machine* m, rom const* r, char const* dir) {
+        uint8_t state[STATE_SIZE];
+        if (boot_snapshot(r, dir, state)) {
+                return 1;
+        }
+        return state_load(m, state, STATE_SIZE);
+}
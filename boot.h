@@ -0,0 +1,25 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+#include "state.h"
+
+// Fast boot: the save state of a machine that has run BOOT_FRAMES frames
+// from power-on, by which point the ROM has finished its self tests and
+// cleared its RAM and attract mode is running. The state is computed once
+// per ROM and cached on disk as <dir>/<rom hash>.boot; a cached file is only
+// used if its ROM hash, frame count and state checksum all match.
+//
+// File layout: "SIBT" u16 version u16 reserved u64 rom hash u32 frames
+// u32 reserved u64 state hash, then the save state.
+#define BOOT_FRAMES 180
+#define BOOT_VERSION 1
+
+int boot_snapshot(rom const* r, char const* dir, uint8_t state[STATE_SIZE]);
+int boot_machine(machine* m, rom const* r, char const* dir);
+
+#endif
@@ -0,0 +1,127 @@
+#include "cow.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+
+cow* cow_new(size_t npages) {
+        cow* c = malloc(sizeof(cow));
+        if (!c) {
+                return 0;
+        }
+        *c = (cow){.pages = calloc(npages, sizeof(cow_page)),
+                   .npages = npages};
+        if (!c->pages) {
+                fprintf(stderr, "Failed to allocate %zu cow pages\n", npages);
+                cow_delete(c);
+                return 0;
+        }
+
+        for (size_t i = npages; i > 0; --i) {
+                c->pages[i - 1].next = c->free;
+                c->free = &c->pages[i - 1];
+        }
+
+        return c;
+}
+
+void cow_delete(cow* c) {
+        if (!c) {
+                return;
+        }
+        free(c->pages);
+        free(c);
+}
+
+static void page_release(cow* c, cow_page* page) {
+        if (page && !--page->refs) {
+                page->next = c->free;
+                c->free = page;
+                --c->used;
+        }
+}
+
+// Captures m into s. Pages equal to the parent's are shared with it, the
+// others are copied into fresh pages. parent may be null. Returns non-zero
+// when the page heap is exhausted, in which case s holds nothing.
+int cow_capture(cow* c, cow_state* s, machine const* m,
+                cow_state const* parent) {
+        s->cpu = m->cpu;
+        s->pts = m->pts;
+        s->cycles_until_interrupt = m->cycles_until_interrupt;
+        s->cycles_per_interrupt = m->cycles_per_interrupt;
+        s->interrupt = m->interrupt;
+
+        for (size_t i = 0; i < COW_PAGES; ++i) {
+                uint8_t const* data = m->memory + i * COW_PAGE_SIZE;
+                cow_page* shared = parent ? parent->pages[i] : 0;
+                if (shared && !memcmp(shared->data, data, COW_PAGE_SIZE)) {
+                        ++shared->refs;
+                        s->pages[i] = shared;
+                        continue;
+                }
+
+                cow_page* page = c->free;
+                if (!page) {
+                        for (size_t k = 0; k < i; ++k) {
+                                page_release(c, s->pages[k]);
+                        }
+                        memset(s->pages, 0, sizeof(s->pages));
+                        return 1;
+                }
+                c->free = page->next;
+                ++c->used;
+                page->refs = 1;
+                memcpy(page->data, data, COW_PAGE_SIZE);
+                s->pages[i] = page;
+        }
+
+        return 0;
+}
+
+// Loads s into m. m keeps its rom and audio sink.
+void cow_restore(machine* m, cow_state const* s) {
+        uint8_t const* rom = m->cpu.rom;
+        audio_sink audio = m->pts.audio;
+
+        m->cpu = s->cpu;
+        m->cpu.rom = rom;
+        m->cpu.memory = m->memory;
+        m->pts = s->pts;
+        m->pts.audio = audio;
+        m->cycles_until_interrupt = s->cycles_until_interrupt;
+        m->cycles_per_interrupt = s->cycles_per_interrupt;
+        m->interrupt = s->interrupt;
+
+        for (size_t i = 0; i < COW_PAGES; ++i) {
+                memcpy(m->memory + i * COW_PAGE_SIZE, s->pages[i]->data,
+                       COW_PAGE_SIZE);
+        }
+}
+
+// Makes dst a second reference to src without copying any RAM. Returns
+// non-zero, leaving dst alone, when src holds nothing, as after a failed
+// capture.
+int cow_share(cow_state* dst, cow_state const* src) {
+        for (size_t i = 0; i < COW_PAGES; ++i) {
+                if (!src->pages[i]) {
+                        fprintf(stderr, "Sharing an empty cow state\n");
+                        return 1;
+                }
+        }
+        *dst = *src;
+        for (size_t i = 0; i < COW_PAGES; ++i) {
+                ++dst->pages[i]->refs;
+        }
+        return 0;
+}
+
+void cow_release(cow* c, cow_state* s) {
+        for (size_t i = 0; i < COW_PAGES; ++i) {
+                page_release(c, s->pages[i]);
+                s->pages[i] = 0;
+        }
+}
@@ -0,0 +1,51 @@
+#ifndef COW_H
+#define COW_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "machine.h"
+#include "ports.h"
+
+#define COW_PAGE_SIZE 256
+#define COW_PAGES (MACHINE_RAM_SIZE / COW_PAGE_SIZE)
+
+// Copy-on-write machine states for search trees. A state holds the
+// registers, ports and scheduler by value and its RAM as reference counted
+// pages. Capturing a machine against a parent state only allocates the
+// pages that differ from the parent, and sharing a state only bumps
+// reference counts, so thousands of sibling states cost little more than
+// the pages each of them actually changed.
+typedef struct cow_page {
+        size_t refs;
+        struct cow_page* next;
+        uint8_t data[COW_PAGE_SIZE];
+} cow_page;
+
+typedef struct {
+        cpu cpu;
+        ports pts;
+        size_t cycles_until_interrupt;
+        size_t cycles_per_interrupt;
+        uint8_t interrupt;
+        cow_page* pages[COW_PAGES];
+} cow_state;
+
+// Fixed-size page heap all states of one tree allocate from.
+typedef struct {
+        cow_page* pages;
+        cow_page* free;
+        size_t npages;
+        size_t used;
+} cow;
+
+cow* cow_new(size_t npages);
+void cow_delete(cow* c);
+int cow_capture(cow* c, cow_state* s, machine const* m,
+                cow_state const* parent);
+void cow_restore(machine* m, cow_state const* s);
+int cow_share(cow_state* dst, cow_state const* src);
+void cow_release(cow* c, cow_state* s);
+
+#endif
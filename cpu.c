@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "opstats.h"
+
 size_t op_cycles[] = {
     4,  10, 7,  5,  5,  5,  7,  4,  4,  10, 7,  5,  5,  5,  7, 4,
     4,  10, 7,  5,  5,  5,  7,  4,  4,  10, 7,  5,  5,  5,  7, 4,
@@ -26,53 +28,52 @@ size_t op_cycles[] = {
     11, 10, 10, 4,  17, 11, 7,  11, 11, 5,  10, 4,  17, 17, 7, 11,
 };
 
-cpu* cpu_new(size_t memsize) {
-        cpu* state = malloc(sizeof(cpu));
-        if (!state) {
-                return 0;
-        }
-
-        *state = (cpu){0};
-        state->memory = calloc(memsize, sizeof(uint8_t));
-        if (!state->memory) {
-                return 0;
-        }
-
-        return state;
-}
-
-void cpu_delete(cpu* state) {
-        if (!state) {
-                return;
-        }
-        free(state->memory);
-        free(state);
-}
-
-void cpu_write(cpu* state, uint16_t addr, uint8_t data) {
-        if (addr < 0x2000) {
+static void store(cpu* state, uint16_t addr, uint8_t data) {
+        if (addr < CPU_RAM_START) {
                 // fprintf(stderr, "tried to write to ROM: $%04x #$%02x\n",
                 // addr,
                 //         data);
                 return;
-        } else if (addr >= 0x4000) {
+        } else if (addr >= CPU_RAM_END) {
                 // fprintf(
                 //     stderr,
                 //     "tried to write to inaccessible address: $%04x #$%02x\n",
                 //     addr, data);
                 return;
         }
-        state->memory[addr] = data;
+        state->memory[addr - CPU_RAM_START] = data;
 }
 
-uint8_t cpu_read(cpu const* state, uint16_t addr) {
-        if (addr >= 0x4000) {
+static uint8_t load(cpu const* state, uint16_t addr) {
+        if (addr < CPU_RAM_START) {
+                return state->rom[addr];
+        } else if (addr >= CPU_RAM_END) {
                 // fprintf(stderr,
                 //         "tried to read from inaccessible address: $%04x\n",
                 //         addr);
                 return 0;
         }
-        return state->memory[addr];
+        return state->memory[addr - CPU_RAM_START];
+}
+
+void cpu_write(cpu* state, uint16_t addr, uint8_t data) {
+        OPSTATS_WRITE(opstats_region_of(addr));
+        store(state, addr, data);
+}
+
+uint8_t cpu_read(cpu const* state, uint16_t addr) {
+        OPSTATS_READ(opstats_region_of(addr));
+        return load(state, addr);
+}
+
+static void stack_write(cpu* state, uint16_t addr, uint8_t data) {
+        OPSTATS_WRITE(OPSTATS_STACK);
+        store(state, addr, data);
+}
+
+static uint8_t stack_read(cpu const* state, uint16_t addr) {
+        OPSTATS_READ(OPSTATS_STACK);
+        return load(state, addr);
 }
 
 void unimplementedInstruction(uint8_t opcode) {
@@ -160,15 +161,15 @@ void call(cpu* state) {
         uint16_t addr =
             cpu_read(state, state->pc + 1) << 8 | cpu_read(state, state->pc);
 
-        cpu_write(state, state->sp - 1, (ret >> 8) & 0xff);
-        cpu_write(state, state->sp - 2, (ret & 0xff));
+        stack_write(state, state->sp - 1, (ret >> 8) & 0xff);
+        stack_write(state, state->sp - 2, (ret & 0xff));
         state->sp -= 2;
         state->pc = addr;
 }
 
 void ret(cpu* state) {
-        state->pc =
-            (cpu_read(state, state->sp + 1) << 8) | cpu_read(state, state->sp);
+        state->pc = (stack_read(state, state->sp + 1) << 8) |
+                    stack_read(state, state->sp);
         state->sp += 2;
 }
 
@@ -511,7 +512,9 @@ size_t cpu_emulateOp(cpu* state) {
                                 //     hl);
                                 break;
                         }
-                        inr(state, &state->memory[hl]);
+                        OPSTATS_READ(opstats_region_of(hl));
+                        OPSTATS_WRITE(opstats_region_of(hl));
+                        inr(state, &state->memory[hl - CPU_RAM_START]);
                         break;
                 }
                 case 0x35:  // DCR M
@@ -532,7 +535,9 @@ size_t cpu_emulateOp(cpu* state) {
                                 //     hl);
                                 break;
                         }
-                        dcr(state, &state->memory[hl]);
+                        OPSTATS_READ(opstats_region_of(hl));
+                        OPSTATS_WRITE(opstats_region_of(hl));
+                        dcr(state, &state->memory[hl - CPU_RAM_START]);
                         break;
                 }
                 case 0x36:  // MVI M d8
@@ -1251,15 +1256,15 @@ size_t cpu_emulateOp(cpu* state) {
                         if (state->cc.z) {
                                 break;
                         }
-                        state->pc = (cpu_read(state, state->sp + 1) << 8) |
-                                    cpu_read(state, state->sp);
+                        state->pc = (stack_read(state, state->sp + 1) << 8) |
+                                    stack_read(state, state->sp);
                         state->sp += 2;
                         break;
                 }
                 case 0xc1:  // POP B
                 {
-                        state->b = cpu_read(state, state->sp + 1);
-                        state->c = cpu_read(state, state->sp);
+                        state->b = stack_read(state, state->sp + 1);
+                        state->c = stack_read(state, state->sp);
                         state->sp += 2;
                         break;
                 }
@@ -1290,8 +1295,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xc5:  // PUSH B
                 {
-                        cpu_write(state, state->sp - 1, state->b);
-                        cpu_write(state, state->sp - 2, state->c);
+                        stack_write(state, state->sp - 1, state->b);
+                        stack_write(state, state->sp - 2, state->c);
                         state->sp -= 2;
                         break;
                 }
@@ -1310,8 +1315,8 @@ size_t cpu_emulateOp(cpu* state) {
                         if (!state->cc.z) {
                                 break;
                         }
-                        state->pc = (cpu_read(state, state->sp + 1) << 8) |
-                                    cpu_read(state, state->sp);
+                        state->pc = (stack_read(state, state->sp + 1) << 8) |
+                                    stack_read(state, state->sp);
                         state->sp += 2;
                         break;
                 }
@@ -1368,8 +1373,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xd1:  // POP D
                 {
-                        state->d = cpu_read(state, state->sp + 1);
-                        state->e = cpu_read(state, state->sp);
+                        state->d = stack_read(state, state->sp + 1);
+                        state->e = stack_read(state, state->sp);
                         state->sp += 2;
                         break;
                 }
@@ -1400,8 +1405,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xd5:  // PUSH D
                 {
-                        cpu_write(state, state->sp - 1, state->d);
-                        cpu_write(state, state->sp - 2, state->e);
+                        stack_write(state, state->sp - 1, state->d);
+                        stack_write(state, state->sp - 2, state->e);
                         state->sp -= 2;
                         break;
                 }
@@ -1474,8 +1479,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xe1:  // POP H
                 {
-                        state->h = cpu_read(state, state->sp + 1);
-                        state->l = cpu_read(state, state->sp);
+                        state->h = stack_read(state, state->sp + 1);
+                        state->l = stack_read(state, state->sp);
                         state->sp += 2;
                         break;
                 }
@@ -1493,11 +1498,11 @@ size_t cpu_emulateOp(cpu* state) {
                 case 0xe3:  // XTHL
                 {
                         uint8_t tmp = state->h;
-                        state->h = cpu_read(state, state->sp + 1);
-                        cpu_write(state, state->sp + 1, tmp);
+                        state->h = stack_read(state, state->sp + 1);
+                        stack_write(state, state->sp + 1, tmp);
                         tmp = state->l;
-                        state->l = cpu_read(state, state->sp);
-                        cpu_write(state, state->sp, tmp);
+                        state->l = stack_read(state, state->sp);
+                        stack_write(state, state->sp, tmp);
                         break;
                 }
                 case 0xe4:  // CPO addr
@@ -1511,8 +1516,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xe5:  // PUSH H
                 {
-                        cpu_write(state, state->sp - 1, state->h);
-                        cpu_write(state, state->sp - 2, state->l);
+                        stack_write(state, state->sp - 1, state->h);
+                        stack_write(state, state->sp - 2, state->l);
                         state->sp -= 2;
                         break;
                 }
@@ -1592,8 +1597,8 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xf1:  // POP PSW
                 {
-                        state->a = cpu_read(state, state->sp + 1);
-                        uint8_t psw = cpu_read(state, state->sp);
+                        state->a = stack_read(state, state->sp + 1);
+                        uint8_t psw = stack_read(state, state->sp);
                         state->cc.z = 0x01 == (psw & 0x01);
                         state->cc.s = 0x02 == (psw & 0x02);
                         state->cc.p = 0x04 == (psw & 0x04);
@@ -1628,11 +1633,11 @@ size_t cpu_emulateOp(cpu* state) {
                 }
                 case 0xf5:  // PUSH PSW
                 {
-                        cpu_write(state, state->sp - 1, state->a);
+                        stack_write(state, state->sp - 1, state->a);
                         uint8_t psw =
                             (state->cc.z | state->cc.s << 1 | state->cc.p << 2 |
                              state->cc.cy << 3 | state->cc.ac << 4);
-                        cpu_write(state, state->sp - 2, psw);
+                        stack_write(state, state->sp - 2, psw);
                         state->sp -= 2;
                         break;
                 }
@@ -1703,12 +1708,13 @@ size_t cpu_emulateOp(cpu* state) {
                 }
         }
 
+        OPSTATS_OP(opcode, op_cycles[opcode]);
         return op_cycles[opcode];
 }
 
 void cpu_interrupt(cpu* state, uint8_t interrupt_num) {
-        cpu_write(state, state->sp - 1, (state->pc >> 8) & 0xff);
-        cpu_write(state, state->sp - 2, state->pc & 0xff);
+        stack_write(state, state->sp - 1, (state->pc >> 8) & 0xff);
+        stack_write(state, state->sp - 2, state->pc & 0xff);
         state->sp -= 2;
 
         state->pc = 8 * interrupt_num;
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+// 0x0000-0x1fff is read-only and served from rom, which may be shared by any
+// number of cpus. 0x2000-0x3fff is the cpu's own ram.
+#define CPU_RAM_START 0x2000
+#define CPU_RAM_END 0x4000
+
 typedef struct {
         // NOTE: these are "bit fields"
         // the number after the colon describes how many bits that field uses
@@ -25,13 +30,12 @@ typedef struct {
         uint8_t l;
         uint16_t sp;
         uint16_t pc;
+        uint8_t const* rom;
         uint8_t* memory;
         cpu_conditionCodes cc;
         uint8_t int_enable;
 } cpu;
 
-cpu* cpu_new(size_t memsize);
-void cpu_delete(cpu* state);
 size_t cpu_emulateOp(cpu* state);
 void cpu_interrupt(cpu* state, uint8_t interrupt_num);
 uint8_t cpu_read(cpu const* state, uint16_t addr);
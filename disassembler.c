@@ -303,3 +303,8 @@ int disassembleOp(uint16_t pc, uint8_t const* memory, char* s) {
 
         return -1;
 }
+
+// The mnemonic of op without its operands, e.g. "MVI B".
+char const* opcodeName(uint8_t op) {
+        return opcodes[op].instruction ? opcodes[op].instruction : "-";
+}
@@ -4,5 +4,6 @@
 #include <stdint.h>
 
 int disassembleOp(uint16_t pc, uint8_t const* memory, char* s);
+char const* opcodeName(uint8_t op);
 
 #endif
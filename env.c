@@ -0,0 +1,162 @@
+#include "env.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gamestate.h"
+#include "machine.h"
+#include "ports.h"
+#include "rom.h"
+
+// Frames to let the ROM finish its power-on tests, to hold a button down,
+// and to wait for the game to react to it.
+#define BOOT_FRAMES 180
+#define PRESS_FRAMES 4
+#define SETTLE_FRAMES 60
+#define START_TIMEOUT_FRAMES 600
+
+static uint8_t ram(machine const* m, uint16_t addr) {
+        return cpu_read(&m->cpu, addr);
+}
+
+static unsigned score(machine const* m) {
+        return gamestate_score(m, GS_P1_SCORE);
+}
+
+static void frames(machine* m, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+                machine_run(m, machine_frame_cycles(m));
+        }
+}
+
+// Boots the machine, inserts a coin and starts a one-player game. The
+// resulting machine is kept as the start state for every later episode.
+static int boot(env* e) {
+        machine* m = e->start;
+        frames(m, BOOT_FRAMES);
+
+        m->pts.inp1.bits.credit = 1;
+        frames(m, PRESS_FRAMES);
+        m->pts.inp1.bits.credit = 0;
+        frames(m, SETTLE_FRAMES);
+
+        m->pts.inp1.bits.p1_start = 1;
+        frames(m, PRESS_FRAMES);
+        m->pts.inp1.bits.p1_start = 0;
+
+        for (size_t i = 0; i < START_TIMEOUT_FRAMES; ++i) {
+                if (ram(m, GS_GAME_MODE)) {
+                        e->started = 1;
+                        return 0;
+                }
+                frames(m, 1);
+        }
+
+        fprintf(stderr, "env: game did not start, wrong ROM?\n");
+        return 1;
+}
+
+env* env_new(rom const* r) {
+        env* e = malloc(sizeof(env));
+        if (!e) {
+                return 0;
+        }
+        *e = (env){
+            .m = machine_new(r, (audio_sink){0}),
+            .start = machine_new(r, (audio_sink){0}),
+        };
+        if (!e->m || !e->start) {
+                env_delete(e);
+                return 0;
+        }
+        return e;
+}
+
+void env_delete(env* e) {
+        if (!e) {
+                return;
+        }
+        machine_delete(e->m);
+        machine_delete(e->start);
+        free(e);
+}
+
+int env_reset(env* e, env_result* out) {
+        if (!e->started && boot(e)) {
+                return 1;
+        }
+
+        machine_reset(e->m, e->start);
+        e->score = score(e->m);
+        e->done = 0;
+        e->frame = 0;
+
+        memcpy(e->prev_vram, machine_vram(e->m), MACHINE_VRAM_SIZE);
+        *out = (env_result){
+            .obs = machine_vram(e->m),
+            .prev_obs = e->prev_vram,
+        };
+        return 0;
+}
+
+// Lets dst start its episodes from the state src booted into, so a batch
+// of environments only runs the boot sequence once.
+int env_share_start(env* dst, env const* src) {
+        if (!src->started) {
+                return 1;
+        }
+        machine_reset(dst->start, src->start);
+        dst->started = 1;
+        return 0;
+}
+
+// Holds action for frameskip frames (at least one) and reports the score
+// gained meanwhile. Stepping a finished episode is an error.
+int env_step(env* e, env_action action, size_t frameskip, env_result* out) {
+        if (e->done || action >= ENV_NUM_ACTIONS) {
+                return 1;
+        }
+
+        int fire = action == ENV_FIRE || action == ENV_RIGHT_FIRE ||
+                   action == ENV_LEFT_FIRE;
+        int right = action == ENV_RIGHT || action == ENV_RIGHT_FIRE;
+        int left = action == ENV_LEFT || action == ENV_LEFT_FIRE;
+
+        ports* pts = &e->m->pts;
+        pts->inp1.bits.p1_shot = fire;
+        pts->inp1.bits.p1_right = right;
+        pts->inp1.bits.p1_left = left;
+        pts->inp2.bits.p2_shot = fire;
+        pts->inp2.bits.p2_right = right;
+        pts->inp2.bits.p2_left = left;
+
+        if (!frameskip) {
+                frameskip = 1;
+        }
+        for (size_t i = 0; i < frameskip; ++i) {
+                memcpy(e->prev_vram, machine_vram(e->m), MACHINE_VRAM_SIZE);
+                machine_run(e->m, machine_frame_cycles(e->m));
+                ++e->frame;
+                if (!ram(e->m, GS_GAME_MODE)) {
+                        e->done = 1;
+                        break;
+                }
+        }
+
+        // the four digit score rolls over at 9999
+        unsigned now = score(e->m);
+        int reward = (int)now - (int)e->score;
+        if (reward < 0) {
+                reward += 10000;
+        }
+        *out = (env_result){
+            .obs = machine_vram(e->m),
+            .prev_obs = e->prev_vram,
+            .reward = reward,
+            .done = e->done,
+        };
+        e->score = now;
+        return 0;
+}
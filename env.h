@@ -0,0 +1,52 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+// Reinforcement-learning environment on top of one headless machine.
+// Player 1 plays a one-player game; an episode starts right after the start
+// button is pressed and ends when the game returns to attract mode. Rewards
+// are the change of player 1's score. Everything is deterministic: the same
+// actions from env_reset always produce the same episode.
+
+typedef enum {
+        ENV_NOOP,
+        ENV_FIRE,
+        ENV_RIGHT,
+        ENV_LEFT,
+        ENV_RIGHT_FIRE,
+        ENV_LEFT_FIRE,
+        ENV_NUM_ACTIONS
+} env_action;
+
+// obs points at the machine's video RAM (MACHINE_VRAM_SIZE bytes, 1bpp,
+// rotated) and prev_obs at a copy of it from the frame before, for
+// max-pooling. Both stay valid until the next call on the same env.
+typedef struct {
+        uint8_t const* obs;
+        uint8_t const* prev_obs;
+        int reward;
+        int done;
+} env_result;
+
+typedef struct {
+        machine* m;
+        machine* start;
+        int started;
+        unsigned score;
+        int done;
+        size_t frame;
+        uint8_t prev_vram[MACHINE_VRAM_SIZE];
+} env;
+
+env* env_new(rom const* r);
+void env_delete(env* e);
+int env_reset(env* e, env_result* out);
+int env_share_start(env* dst, env const* src);
+int env_step(env* e, env_action action, size_t frameskip, env_result* out);
+
+#endif
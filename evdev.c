@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+
+#include "evdev.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+
+#include <fcntl.h>
+#include <glob.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+static char const* const bit_names[2][8] = {
+    {"credit", "p2_start", "p1_start", 0, "p1_shot", "p1_left", "p1_right",
+     0},
+    {"dip3", "dip5", "tilt", "dip6", "p2_shot", "p2_left", "p2_right",
+     "dip7"},
+};
+
+uint64_t evdev_now_ms() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+static int add_device(evdev* ev, char const* path) {
+        if (ev->nfds == EVDEV_MAX_DEVICES) {
+                fprintf(stderr, "evdev: too many devices, ignoring %s\n",
+                        path);
+                return 0;
+        }
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+                fprintf(stderr, "evdev: failed to open %s\n", path);
+                return 1;
+        }
+        // timestamps comparable to evdev_now_ms; fails harmlessly on
+        // anything that is not an event device
+        int clk = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clk);
+        ev->fds[ev->nfds++] = fd;
+        return 0;
+}
+
+static int parse_key(evdev* ev, char const* line, char const* path,
+                     size_t lineno) {
+        unsigned long code = 0;
+        char port[16] = "";
+        char bit[16] = "";
+        char* end = 0;
+        code = strtoul(line, &end, 0);
+        if (end == line || sscanf(end, "%15s %15s", port, bit) != 2) {
+                fprintf(stderr, "%s:%zu: expected <code> inp1|inp2 <bit>\n",
+                        path, lineno);
+                return 1;
+        }
+        int p = !strcmp(port, "inp1") ? 1 : !strcmp(port, "inp2") ? 2 : 0;
+        for (int b = 0; p && b < 8; ++b) {
+                char const* name = bit_names[p - 1][b];
+                if (!name || strcmp(name, bit)) {
+                        continue;
+                }
+                if (ev->nkeys == EVDEV_MAX_KEYS) {
+                        fprintf(stderr, "%s:%zu: too many keys\n", path,
+                                lineno);
+                        return 1;
+                }
+                ev->keys[ev->nkeys++] =
+                    (evdev_key){.code = code, .port = p, .mask = 1 << b};
+                return 0;
+        }
+        fprintf(stderr, "%s:%zu: unknown port bit %s %s\n", path, lineno,
+                port, bit);
+        return 1;
+}
+
+static int load_config(evdev* ev, char const* path) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+                fprintf(stderr, "Failed to open evdev config: %s\n", path);
+                return 1;
+        }
+        size_t lineno = 0;
+        char line[256] = "";
+        int err = 0;
+        while (!err && fgets(line, sizeof(line), f)) {
+                ++lineno;
+                char* hash = strchr(line, '#');
+                if (hash) {
+                        *hash = 0;
+                }
+                char word[16] = "";
+                char device[200] = "";
+                if (sscanf(line, "%15s", word) != 1) {
+                        continue;
+                }
+                if (!strcmp(word, "device")) {
+                        if (sscanf(line, "%*s %199s", device) != 1) {
+                                fprintf(stderr, "%s:%zu: expected a path\n",
+                                        path, lineno);
+                                err = 1;
+                        } else {
+                                err = add_device(ev, device);
+                        }
+                } else {
+                        err = parse_key(ev, line, path, lineno);
+                }
+        }
+        fclose(f);
+        return err;
+}
+
+static void publish(evdev* ev, uint64_t ms) {
+        size_t head = ev->head;
+        size_t tail = __atomic_load_n(&ev->tail, __ATOMIC_ACQUIRE);
+        if (head - tail == EVDEV_RING_SIZE) {
+                fprintf(stderr, "evdev: input ring full, dropping event\n");
+                return;
+        }
+        ev->ring[head % EVDEV_RING_SIZE] =
+            (evdev_event){.ms = ms, .inp1 = ev->inp[0], .inp2 = ev->inp[1]};
+        __atomic_store_n(&ev->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void handle(evdev* ev, struct input_event const* ie) {
+        // value 2 is autorepeat, which changes nothing
+        if (ie->type != EV_KEY || ie->value > 1) {
+                return;
+        }
+        uint8_t before[2] = {ev->inp[0], ev->inp[1]};
+        ev->inp[0] = 0;
+        ev->inp[1] = 0;
+        for (size_t i = 0; i < ev->nkeys; ++i) {
+                evdev_key* k = &ev->keys[i];
+                if (k->code == ie->code) {
+                        k->pressed = ie->value;
+                }
+                if (k->pressed) {
+                        ev->inp[k->port - 1] |= k->mask;
+                }
+        }
+        if (before[0] != ev->inp[0] || before[1] != ev->inp[1]) {
+                publish(ev, ie->time.tv_sec * 1000ull +
+                                ie->time.tv_usec / 1000);
+        }
+}
+
+static void* evdev_main(void* arg) {
+        evdev* ev = arg;
+        struct epoll_event ready[EVDEV_MAX_DEVICES + 1];
+        for (;;) {
+                int n = epoll_wait(ev->epoll, ready,
+                                   EVDEV_MAX_DEVICES + 1, -1);
+                for (int i = 0; i < n; ++i) {
+                        int fd = ready[i].data.fd;
+                        if (fd == ev->wake) {
+                                return 0;
+                        }
+                        struct input_event events[64];
+                        ssize_t size = 0;
+                        while ((size = read(fd, events, sizeof(events))) >
+                               0) {
+                                for (size_t k = 0;
+                                     k < size / sizeof(events[0]); ++k) {
+                                        handle(ev, &events[k]);
+                                }
+                        }
+                        if (size == 0 ||
+                            (ready[i].events & (EPOLLHUP | EPOLLERR))) {
+                                // device unplugged
+                                epoll_ctl(ev->epoll, EPOLL_CTL_DEL, fd, 0);
+                        }
+                }
+        }
+        return 0;
+}
+
+evdev* evdev_open(char const* config) {
+        evdev* ev = calloc(1, sizeof(evdev));
+        if (!ev) {
+                return 0;
+        }
+        ev->epoll = -1;
+        ev->wake = -1;
+        if (load_config(ev, config)) {
+                evdev_close(ev);
+                return 0;
+        }
+
+        if (!ev->nfds) {
+                glob_t g;
+                if (!glob("/dev/input/event*", 0, 0, &g)) {
+                        for (size_t i = 0; i < g.gl_pathc; ++i) {
+                                add_device(ev, g.gl_pathv[i]);
+                        }
+                        globfree(&g);
+                }
+        }
+        if (!ev->nfds) {
+                fprintf(stderr, "evdev: no input devices\n");
+                evdev_close(ev);
+                return 0;
+        }
+
+        ev->epoll = epoll_create1(EPOLL_CLOEXEC);
+        ev->wake = eventfd(0, EFD_CLOEXEC);
+        int err = ev->epoll < 0 || ev->wake < 0;
+        for (size_t i = 0; i < ev->nfds && !err; ++i) {
+                struct epoll_event e = {.events = EPOLLIN,
+                                        .data.fd = ev->fds[i]};
+                err = epoll_ctl(ev->epoll, EPOLL_CTL_ADD, ev->fds[i], &e);
+        }
+        struct epoll_event e = {.events = EPOLLIN, .data.fd = ev->wake};
+        if (err || epoll_ctl(ev->epoll, EPOLL_CTL_ADD, ev->wake, &e) ||
+            pthread_create(&ev->thread, 0, evdev_main, ev)) {
+                fprintf(stderr, "evdev: failed to start input thread\n");
+                evdev_close(ev);
+                return 0;
+        }
+        ev->running = 1;
+        return ev;
+}
+
+void evdev_close(evdev* ev) {
+        if (!ev) {
+                return;
+        }
+        if (ev->running) {
+                uint64_t one = 1;
+                if (write(ev->wake, &one, sizeof(one)) == sizeof(one)) {
+                        pthread_join(ev->thread, 0);
+                }
+        }
+        for (size_t i = 0; i < ev->nfds; ++i) {
+                close(ev->fds[i]);
+        }
+        if (ev->epoll >= 0) {
+                close(ev->epoll);
+        }
+        if (ev->wake >= 0) {
+                close(ev->wake);
+        }
+        free(ev);
+}
+
+// Takes the oldest change not seen yet. Returns 0 when there is none.
+int evdev_next(evdev* ev, evdev_event* e) {
+        size_t tail = ev->tail;
+        if (tail == __atomic_load_n(&ev->head, __ATOMIC_ACQUIRE)) {
+                return 0;
+        }
+        *e = ev->ring[tail % EVDEV_RING_SIZE];
+        __atomic_store_n(&ev->tail, tail + 1, __ATOMIC_RELEASE);
+        return 1;
+}
+
+// Whether evdev_next has a change to take.
+int evdev_pending(evdev* ev) {
+        return ev->tail != __atomic_load_n(&ev->head, __ATOMIC_ACQUIRE);
+}
+
+#else
+
+uint64_t evdev_now_ms() { return 0; }
+
+evdev* evdev_open(char const* config) {
+        fprintf(stderr, "evdev input is only available on Linux\n");
+        return 0;
+}
+
+void evdev_close(evdev* ev) {}
+
+int evdev_next(evdev* ev, evdev_event* e) { return 0; }
+
+int evdev_pending(evdev* ev) { return 0; }
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef EVDEV_H
+#define EVDEV_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Linux evdev input: a thread waits on the input devices with epoll and
+// turns key and button events into input port values as soon as the kernel
+// delivers them, without going through SDL's event polling. Every change is
+// handed to the emulation thread through a single-producer single-consumer
+// ring together with its kernel timestamp (CLOCK_MONOTONIC, in ms). The
+// emulation thread checks evdev_pending between its updates and updates
+// right away when it is set, so a change reaches the ports without waiting
+// for the next update tick. A port bit stays set while any key mapped to it
+// is held.
+//
+// The config file maps key codes (see linux/input-event-codes.h) to port
+// bits, one per line, and optionally names the devices to read; without a
+// device line every /dev/input/event* device is used:
+//
+//     device /dev/input/event3
+//     57 inp1 p1_shot           # KEY_SPACE
+//     0x130 inp1 p1_shot        # BTN_SOUTH
+//
+// Bit names are the fields of ports_inp1_s and ports_inp2_s. A virtual
+// device created through /dev/uinput can be named like any other device.
+#define EVDEV_MAX_DEVICES 16
+#define EVDEV_MAX_KEYS 64
+#define EVDEV_RING_SIZE 256
+
+typedef struct {
+        uint64_t ms;
+        uint8_t inp1;
+        uint8_t inp2;
+} evdev_event;
+
+typedef struct {
+        uint16_t code;
+        uint8_t port;  // 1 for inp1, 2 for inp2
+        uint8_t mask;
+        uint8_t pressed;  // owned by the thread
+} evdev_key;
+
+typedef struct {
+        int fds[EVDEV_MAX_DEVICES];
+        size_t nfds;
+        int epoll;
+        int wake;
+        pthread_t thread;
+        int running;
+
+        evdev_key keys[EVDEV_MAX_KEYS];
+        size_t nkeys;
+        uint8_t inp[2];  // owned by the thread
+
+        // ring written by the thread, read by the emulation thread
+        evdev_event ring[EVDEV_RING_SIZE];
+        size_t head;
+        size_t tail;
+} evdev;
+
+evdev* evdev_open(char const* config);
+void evdev_close(evdev* ev);
+int evdev_next(evdev* ev, evdev_event* e);
+int evdev_pending(evdev* ev);
+uint64_t evdev_now_ms();
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include <stdint.h>
+
+#include "audio.h"
+#include "ports.h"
+
+// Receives the 1bpp video RAM (MACHINE_VRAM_SIZE bytes starting at
+// MACHINE_VRAM) whenever the frontend wants to show a frame.
+typedef struct {
+        void* ctx;
+        void (*present)(void* ctx, uint8_t const* vram);
+} video_sink;
+
+// Updates the input ports. Returns non-zero when the frontend wants to quit.
+typedef struct {
+        void* ctx;
+        int (*poll)(void* ctx, ports* pts);
+} input_source;
+
+typedef struct {
+        video_sink video;
+        audio_sink audio;
+        input_source input;
+} frontend;
+
+#endif
@@ -0,0 +1,79 @@
+#include "gamestate.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "machine.h"
+
+static uint8_t ram(machine const* m, uint16_t addr) {
+        return m->memory[addr - CPU_RAM_START];
+}
+
+static unsigned bcd(uint8_t v) { return (v >> 4) * 10 + (v & 0xf); }
+
+// Reads a four digit BCD score stored low byte first.
+uint16_t gamestate_score(machine const* m, uint16_t addr) {
+        return bcd(ram(m, addr + 1)) * 100 + bcd(ram(m, addr));
+}
+
+static gamestate_shot alien_shot(machine const* m, uint16_t obj) {
+        return (gamestate_shot){
+            .active = ram(m, obj + GS_ALIEN_SHOT_STATUS) != 0,
+            .x = ram(m, obj + GS_ALIEN_SHOT_X),
+            .y = ram(m, obj + GS_ALIEN_SHOT_Y),
+        };
+}
+
+void gamestate_read(machine const* m, gamestate* gs) {
+        uint8_t page = ram(m, GS_PLAYER_DATA);
+        if (page != 0x21 && page != 0x22) {
+                page = 0x21;
+        }
+        uint16_t data = page << 8;
+
+        uint64_t aliens = 0;
+        for (size_t i = 0; i < GAMESTATE_ALIENS; ++i) {
+                aliens |= (uint64_t)(ram(m, data + GS_ALIENS + i) != 0) << i;
+        }
+
+        *gs = (gamestate){
+            .in_game = ram(m, GS_GAME_MODE) != 0,
+            .player = page - 0x21,
+            .player_alive = ram(m, GS_PLAYER_ALIVE) == 0xff,
+            .player_x = ram(m, GS_PLAYER_X),
+
+            .aliens = aliens,
+            .num_aliens = ram(m, GS_NUM_ALIENS),
+            .ref_alien_x = ram(m, GS_REF_ALIEN_X),
+            .ref_alien_y = ram(m, GS_REF_ALIEN_Y),
+            .marching_left = ram(m, GS_RACK_DIRECTION) != 0,
+
+            .player_shot =
+                {
+                    .active = ram(m, GS_PLAYER_SHOT_STATUS) != 0,
+                    .x = ram(m, GS_PLAYER_SHOT_X),
+                    .y = ram(m, GS_PLAYER_SHOT_Y),
+                },
+            .alien_shots =
+                {
+                    alien_shot(m, GS_ROLLING_SHOT),
+                    alien_shot(m, GS_PLUNGER_SHOT),
+                    alien_shot(m, GS_SQUIGGLY_SHOT),
+                },
+
+            .saucer_active = ram(m, GS_SAUCER_ACTIVE) != 0,
+            .saucer_hit = ram(m, GS_SAUCER_HIT) != 0,
+            .saucer_x = ram(m, GS_SAUCER_X),
+
+            .score =
+                {
+                    gamestate_score(m, GS_P1_SCORE),
+                    gamestate_score(m, GS_P2_SCORE),
+                },
+            .hi_score = gamestate_score(m, GS_HI_SCORE),
+            .ships = ram(m, data + GS_SHIPS),
+            .credits = bcd(ram(m, GS_CREDITS)),
+            .wave = ram(m, data + GS_WAVE),
+        };
+}
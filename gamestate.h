@@ -0,0 +1,90 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+
+// Space Invaders work RAM (0x2000-0x23ff), as mapped out in the Computer
+// Archeology disassembly of the original ROM. Positions are in the game's
+// own rotated coordinates: x runs along the bottom of the upright screen
+// (0 is the left edge), y upwards from the bottom.
+
+#define GS_REF_ALIEN_Y 0x2009    // reference (bottom left) alien y
+#define GS_REF_ALIEN_X 0x200a    // reference alien x
+#define GS_RACK_DIRECTION 0x200d // 0 marching right, 1 marching left
+#define GS_PLAYER_ALIVE 0x2015   // 0xff alive, anything else exploding
+#define GS_PLAYER_X 0x201b       // player ship x
+
+// Shot objects: status byte (0 idle), y and x.
+#define GS_PLAYER_SHOT_STATUS 0x2025
+#define GS_PLAYER_SHOT_Y 0x2029
+#define GS_PLAYER_SHOT_X 0x202a
+#define GS_ROLLING_SHOT 0x2030   // alien shot objects start here, ...
+#define GS_PLUNGER_SHOT 0x2040
+#define GS_SQUIGGLY_SHOT 0x2050
+#define GS_ALIEN_SHOT_STATUS 0x5 // ... and have these fields
+#define GS_ALIEN_SHOT_Y 0xd
+#define GS_ALIEN_SHOT_X 0xe
+
+#define GS_PLAYER_DATA 0x2067    // 0x21 or 0x22: page of the active player
+#define GS_NUM_ALIENS 0x2082     // aliens left in the rack
+#define GS_SAUCER_ACTIVE 0x2084
+#define GS_SAUCER_HIT 0x2085
+#define GS_SAUCER_X 0x2088
+
+#define GS_PLAYER1_ALIVE 0x20e7  // 0 once player 1 lost the last ship
+#define GS_PLAYER2_ALIVE 0x20e8
+#define GS_CREDITS 0x20eb        // BCD
+#define GS_GAME_MODE 0x20ef      // 1 while a game is in play
+#define GS_HI_SCORE 0x20f4       // BCD, low byte first
+#define GS_P1_SCORE 0x20f8       // BCD, low byte first
+#define GS_P2_SCORE 0x20fc       // BCD, low byte first
+
+// Per-player pages (0x2100 player 1, 0x2200 player 2), at these offsets.
+#define GS_ALIENS 0x00           // 55 bytes, 1 if alive, row by row from
+                                 // the bottom left
+#define GS_WAVE 0xfe             // racks cleared
+#define GS_SHIPS 0xff            // ships in reserve
+
+#define GAMESTATE_ALIENS 55
+#define GAMESTATE_ALIEN_COLUMNS 11
+
+typedef struct {
+        uint8_t active;
+        uint8_t x;
+        uint8_t y;
+} gamestate_shot;
+
+typedef struct {
+        uint8_t in_game;
+        uint8_t player;  // active player, 0 or 1
+        uint8_t player_alive;
+        uint8_t player_x;
+
+        // bit i is alien i of GS_ALIENS
+        uint64_t aliens;
+        uint8_t num_aliens;
+        uint8_t ref_alien_x;
+        uint8_t ref_alien_y;
+        uint8_t marching_left;
+
+        gamestate_shot player_shot;
+        gamestate_shot alien_shots[3];
+
+        uint8_t saucer_active;
+        uint8_t saucer_hit;
+        uint8_t saucer_x;
+
+        uint16_t score[2];
+        uint16_t hi_score;
+        uint8_t ships;
+        uint8_t credits;
+        uint8_t wave;
+} gamestate;
+
+void gamestate_read(machine const* m, gamestate* gs);
+uint16_t gamestate_score(machine const* m, uint16_t addr);
+
+#endif
@@ -0,0 +1,13 @@
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+uint64_t hash_bytes(uint64_t hash, void const* data, size_t size) {
+        uint8_t const* p = data;
+        for (size_t i = 0; i < size; ++i) {
+                hash ^= p[i];
+                hash *= 0x100000001b3ull;
+        }
+        return hash;
+}
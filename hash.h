@@ -0,0 +1,13 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// 64-bit FNV-1a. Start from HASH_INIT and feed consecutive buffers through
+// hash_bytes to hash them as one stream.
+#define HASH_INIT 0xcbf29ce484222325ull
+
+uint64_t hash_bytes(uint64_t hash, void const* data, size_t size);
+
+#endif
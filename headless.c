@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frontend.h"
+#include "hash.h"
+#include "machine.h"
+#include "rom.h"
+#include "runner.h"
+#include "script.h"
+
+#ifdef CPU_PROFILE
+#include "opstats.h"
+
+#define OPSTATS_CSV "opstats.csv"
+#define OPSTATS_TOP_PAIRS 40
+#endif
+
+// Hashes every presented frame, so two runs can be compared for
+// bit-exactness without dumping the frames themselves.
+static void hash_present(void* ctx, uint8_t const* vram) {
+        uint64_t* hash = ctx;
+        *hash = hash_bytes(*hash, vram, MACHINE_VRAM_SIZE);
+}
+
+static int no_input(void* ctx, ports* pts) { return 0; }
+
+int main(int argc, char* argv[static argc + 1]) {
+        if (argc < 3) {
+                fprintf(stderr,
+                        "usage: %s ROM FRAMES [SCRIPT|-] [MACHINES] "
+                        "[CLOCK_HZ]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        rom* r = rom_open(argv[1]);
+        if (!r) {
+                return EXIT_FAILURE;
+        }
+
+        size_t frames = strtoul(argv[2], 0, 0);
+
+        size_t hz = MACHINE_CLOCK_HZ;
+        if (argc > 5) {
+                char* end = 0;
+                hz = strtoul(argv[5], &end, 0);
+                if (*end || end == argv[5] || hz < MACHINE_CLOCK_MIN_HZ ||
+                    hz > MACHINE_CLOCK_MAX_HZ) {
+                        fprintf(stderr, "Invalid clock: %s (%d to %d Hz)\n",
+                                argv[5], MACHINE_CLOCK_MIN_HZ,
+                                MACHINE_CLOCK_MAX_HZ);
+                        rom_close(r);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        size_t n = argc > 4 ? strtoul(argv[4], 0, 0) : 1;
+        if (!n) {
+                n = 1;
+        }
+
+        script* s = 0;
+        if (argc > 3 && strcmp(argv[3], "-")) {
+                s = script_load(argv[3]);
+                if (!s) {
+                        rom_close(r);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        uint64_t hash = HASH_INIT;
+        frontend fe = {
+            .video = {.ctx = &hash, .present = hash_present},
+            .input = s ? script_source(s) : (input_source){.poll = no_input},
+        };
+
+        // every machine gets the same input; the first one is hashed
+        runner* g = runner_new(r, n);
+        uint8_t* inp1 = calloc(n, 1);
+        uint8_t* inp2 = calloc(n, 1);
+        if (!g || !inp1 || !inp2) {
+                runner_delete(g);
+                rom_close(r);
+                free(inp1);
+                free(inp2);
+                script_delete(s);
+                return EXIT_FAILURE;
+        }
+
+        // overclocking gives every frame more cycles to run
+        if (argc > 5) {
+                for (size_t i = 0; i < n; ++i) {
+                        machine_set_clock(runner_machine(g, i), hz);
+                }
+        }
+
+        ports pts = {0};
+        clock_t start = clock();
+        for (size_t frame = 0; frame < frames; ++frame) {
+                if (fe.input.poll(fe.input.ctx, &pts)) {
+                        break;
+                }
+                memset(inp1, pts.inp1.value, n);
+                memset(inp2, pts.inp2.value, n);
+                runner_frame(g, inp1, inp2);
+                fe.video.present(fe.video.ctx,
+                                 machine_vram(runner_machine(g, 0)));
+        }
+        double elapsed = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+
+        printf("%zu frames x %zu machines in %.3fs (%.0f frames/s), frame hash "
+               "%016llx\n",
+               frames, n, elapsed, elapsed > 0 ? frames * n / elapsed : 0.0,
+               (unsigned long long)hash);
+
+#ifdef CPU_PROFILE
+        // the instrumented build (make opstats) also reports where the cpu
+        // time went
+        printf("\n");
+        opstats_report(stdout, OPSTATS_TOP_PAIRS);
+        opstats_write_csv(OPSTATS_CSV);
+#endif
+
+        runner_delete(g);
+        rom_close(r);
+        free(inp1);
+        free(inp2);
+        script_delete(s);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include "history.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+#include "state.h"
+
+history* history_new(size_t size) {
+        history* h = malloc(sizeof(history));
+        if (!h) {
+                return 0;
+        }
+        *h = (history){.ring = malloc(size), .size = size};
+        if (!h->ring) {
+                fprintf(stderr, "Failed to allocate %zu bytes of history\n",
+                        size);
+                free(h);
+                return 0;
+        }
+        return h;
+}
+
+void history_delete(history* h) {
+        if (!h) {
+                return;
+        }
+        free(h->ring);
+        free(h);
+}
+
+void history_clear(history* h) {
+        h->head = 0;
+        h->used = 0;
+        h->frames = 0;
+        h->has_current = 0;
+}
+
+static void ring_write(history* h, size_t pos, void const* src, size_t n) {
+        size_t first = h->size - pos < n ? h->size - pos : n;
+        memcpy(h->ring + pos, src, first);
+        memcpy(h->ring, (uint8_t const*)src + first, n - first);
+}
+
+static void ring_read(history const* h, size_t pos, void* dst, size_t n) {
+        size_t first = h->size - pos < n ? h->size - pos : n;
+        memcpy(dst, h->ring + pos, first);
+        memcpy((uint8_t*)dst + first, h->ring, n - first);
+}
+
+static uint8_t* put_varint(uint8_t* p, size_t v) {
+        while (v >= 0x80) {
+                *p++ = v | 0x80;
+                v >>= 7;
+        }
+        *p++ = v;
+        return p;
+}
+
+static uint8_t const* read_varint(uint8_t const* p, size_t* v) {
+        size_t value = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+                value |= (size_t)(*p++ & 0x7f) << shift;
+                shift += 7;
+        }
+        *v = value | (size_t)*p++ << shift;
+        return p;
+}
+
+static size_t encode(uint8_t* out, uint8_t const* a, uint8_t const* b) {
+        uint8_t* p = out;
+        size_t i = 0;
+        while (i < STATE_SIZE) {
+                size_t start = i;
+                while (i + 8 <= STATE_SIZE) {
+                        uint64_t x;
+                        uint64_t y;
+                        memcpy(&x, a + i, 8);
+                        memcpy(&y, b + i, 8);
+                        if (x != y) {
+                                break;
+                        }
+                        i += 8;
+                }
+                while (i < STATE_SIZE && a[i] == b[i]) {
+                        ++i;
+                }
+                if (i == STATE_SIZE) {
+                        break;
+                }
+                size_t equal = i - start;
+
+                // a single equal byte inside a change is cheaper to copy
+                // than to start a new run for
+                start = i;
+                while (i < STATE_SIZE &&
+                       (a[i] != b[i] ||
+                        (i + 1 < STATE_SIZE && a[i + 1] != b[i + 1]))) {
+                        ++i;
+                }
+                p = put_varint(p, equal);
+                p = put_varint(p, i - start);
+                for (size_t k = start; k < i; ++k) {
+                        *p++ = a[k] ^ b[k];
+                }
+        }
+        return p - out;
+}
+
+static void decode(uint8_t* state, uint8_t const* p, size_t n) {
+        uint8_t const* end = p + n;
+        size_t i = 0;
+        while (p < end) {
+                size_t equal = 0;
+                size_t changed = 0;
+                p = read_varint(p, &equal);
+                p = read_varint(p, &changed);
+                i += equal;
+                for (size_t k = 0; k < changed; ++k) {
+                        state[i++] ^= *p++;
+                }
+        }
+}
+
+static void drop_oldest(history* h) {
+        size_t tail = (h->head + h->size - h->used) % h->size;
+        uint32_t n = 0;
+        ring_read(h, tail, &n, 4);
+        h->used -= n + 8;
+        --h->frames;
+}
+
+// Records the state m is in, normally once per frame. Returns non-zero if
+// the ring is too small to hold even a single frame.
+int history_push(history* h, machine const* m) {
+        state_save(m, h->next);
+        if (!h->has_current) {
+                memcpy(h->current, h->next, STATE_SIZE);
+                h->has_current = 1;
+                return 0;
+        }
+
+        uint32_t n = encode(h->delta + 4, h->current, h->next);
+        if (n + 8 > h->size) {
+                fprintf(stderr, "History ring too small\n");
+                return 1;
+        }
+        memcpy(h->delta, &n, 4);
+        memcpy(h->delta + 4 + n, &n, 4);
+        while (h->size - h->used < n + 8) {
+                drop_oldest(h);
+        }
+        ring_write(h, h->head, h->delta, n + 8);
+        h->head = (h->head + n + 8) % h->size;
+        h->used += n + 8;
+        ++h->frames;
+
+        memcpy(h->current, h->next, STATE_SIZE);
+        return 0;
+}
+
+// Restores m to the state pushed before the newest one and forgets the
+// newest. Returns non-zero, leaving m untouched, when there is no older
+// state.
+int history_pop(history* h, machine* m) {
+        if (!h->frames) {
+                return 1;
+        }
+
+        uint32_t n = 0;
+        size_t end = (h->head + h->size - 4) % h->size;
+        ring_read(h, end, &n, 4);
+        size_t start = (h->head + h->size - n - 4) % h->size;
+        ring_read(h, start, h->delta, n);
+        decode(h->current, h->delta, n);
+
+        h->head = (h->head + h->size - n - 8) % h->size;
+        h->used -= n + 8;
+        --h->frames;
+
+        return state_load(m, h->current, STATE_SIZE);
+}
@@ -0,0 +1,39 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "state.h"
+
+// Rewind history: one save state per frame in a fixed-size byte ring. Only
+// the newest state is kept whole; every older frame is stored as the XOR of
+// its state with the next one, run-length encoded, so a frame that changes
+// a few hundred bytes of RAM costs a few hundred bytes of history. Stepping
+// back decodes the newest delta into the newest state. When the ring is
+// full the oldest frames are dropped.
+//
+// Each delta is a u32 length, the encoded bytes and the length again, so
+// the ring can be walked from either end. The encoding is a sequence of
+// (varint equal bytes, varint changed bytes, changed bytes XORed) runs.
+typedef struct {
+        uint8_t* ring;
+        size_t size;
+        size_t head;
+        size_t used;
+        size_t frames;
+
+        int has_current;
+        uint8_t current[STATE_SIZE];
+        uint8_t next[STATE_SIZE];
+        uint8_t delta[2 * STATE_SIZE + 8];
+} history;
+
+history* history_new(size_t size);
+void history_delete(history* h);
+void history_clear(history* h);
+int history_push(history* h, machine const* m);
+int history_pop(history* h, machine* m);
+
+#endif
@@ -0,0 +1,195 @@
+#include "inputlog.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "machine.h"
+#include "rom.h"
+#include "state.h"
+
+typedef struct {
+        uint8_t magic[4];  // "SIIL"
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t rom_hash;
+} inputlog_header;
+
+typedef struct {
+        uint64_t cycle;
+        uint64_t hash;  // INPUTLOG_END only
+        uint8_t kind;
+        uint8_t inp1;
+        uint8_t inp2;
+        uint8_t reserved[5];
+} inputlog_record;
+
+// the record layout is part of the format
+typedef char inputlog_record_size[sizeof(inputlog_record) == 24 ? 1 : -1];
+
+// The hash of m's save state, which covers everything that replays.
+uint64_t inputlog_hash(machine const* m) {
+        uint8_t state[STATE_SIZE];
+        state_save(m, state);
+        return hash_bytes(HASH_INIT, state, STATE_SIZE);
+}
+
+inputlog* inputlog_create(char const* path, rom const* r) {
+        inputlog* log = calloc(1, sizeof(inputlog));
+        if (!log) {
+                fprintf(stderr, "Failed to allocate input log\n");
+                return 0;
+        }
+        log->f = fopen(path, "wb");
+        inputlog_header h = {
+            .magic = {'S', 'I', 'I', 'L'},
+            .version = INPUTLOG_VERSION,
+            .rom_hash = rom_hash(r),
+        };
+        if (!log->f || fwrite(&h, sizeof(h), 1, log->f) != 1) {
+                fprintf(stderr, "Failed to write input log: %s\n", path);
+                if (log->f) {
+                        fclose(log->f);
+                }
+                free(log);
+                return 0;
+        }
+        return log;
+}
+
+static int put(inputlog* log, uint8_t kind, machine const* m) {
+        inputlog_record rec = {
+            .cycle = m->cycles,
+            .kind = kind,
+            .inp1 = m->pts.inp1.value,
+            .inp2 = m->pts.inp2.value,
+        };
+        if (kind == INPUTLOG_END) {
+                rec.hash = inputlog_hash(m);
+        }
+        if (fwrite(&rec, sizeof(rec), 1, log->f) != 1) {
+                fprintf(stderr, "Failed to write input log\n");
+                return 1;
+        }
+        return 0;
+}
+
+// Restarts the log from m as it stands.
+int inputlog_state(inputlog* log, machine const* m) {
+        uint8_t state[STATE_SIZE];
+        state_save(m, state);
+        if (put(log, INPUTLOG_STATE, m) ||
+            fwrite(state, STATE_SIZE, 1, log->f) != 1) {
+                fprintf(stderr, "Failed to write input log\n");
+                return 1;
+        }
+        return 0;
+}
+
+// Logs both input ports of m, called whenever they change.
+int inputlog_ports(inputlog* log, machine const* m) {
+        ++log->events;
+        return put(log, INPUTLOG_PORTS, m);
+}
+
+// Ends the log at m and closes it. Returns non-zero if any of it failed to
+// reach the file.
+int inputlog_close(inputlog* log, machine const* m) {
+        if (!log) {
+                return 0;
+        }
+        int err = put(log, INPUTLOG_END, m);
+        err |= fclose(log->f) != 0;
+        if (!err) {
+                printf("input log: %zu events, state hash %016llx\n",
+                       log->events, (unsigned long long)inputlog_hash(m));
+        }
+        free(log);
+        return err;
+}
+
+// Runs m up to cycle, which has to be an instruction boundary of the
+// recorded session; replaying the same inputs makes it one here too.
+static int run_to(machine* m, uint64_t cycle, inputlog_summary* s) {
+        if (cycle < m->cycles) {
+                fprintf(stderr, "Input log goes back in time at cycle %llu\n",
+                        (unsigned long long)cycle);
+                return 1;
+        }
+        s->cycles += cycle - m->cycles;
+        machine_run(m, cycle - m->cycles);
+        if (m->cycles != cycle) {
+                fprintf(stderr, "Input log out of sync at cycle %llu\n",
+                        (unsigned long long)cycle);
+                return 1;
+        }
+        return 0;
+}
+
+// Replays the log at path on m. Fills in s and returns 0 if the log is
+// complete and was recorded on r; whether m ended in the recorded state is
+// up to the caller to check against s->hash.
+int inputlog_play(char const* path, rom const* r, machine* m,
+                  inputlog_summary* s) {
+        *s = (inputlog_summary){0};
+        FILE* f = fopen(path, "rb");
+        if (!f) {
+                fprintf(stderr, "Failed to open input log: %s\n", path);
+                return 1;
+        }
+        inputlog_header h;
+        if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, "SIIL", 4) ||
+            h.version != INPUTLOG_VERSION) {
+                fprintf(stderr, "Not a version %d input log: %s\n",
+                        INPUTLOG_VERSION, path);
+                fclose(f);
+                return 1;
+        }
+        if (h.rom_hash != rom_hash(r)) {
+                fprintf(stderr, "Input log was recorded with another ROM\n");
+                fclose(f);
+                return 1;
+        }
+
+        int err = 0;
+        int started = 0;
+        inputlog_record rec;
+        uint8_t state[STATE_SIZE];
+        while (!err) {
+                if (fread(&rec, sizeof(rec), 1, f) != 1) {
+                        fprintf(stderr, "Input log is truncated\n");
+                        err = 1;
+                        break;
+                }
+                if (rec.kind == INPUTLOG_STATE) {
+                        if (fread(state, STATE_SIZE, 1, f) != 1) {
+                                fprintf(stderr, "Input log is truncated\n");
+                                err = 1;
+                                break;
+                        }
+                        err = state_load(m, state, STATE_SIZE);
+                        m->cycles = rec.cycle;
+                        started = 1;
+                        ++s->states;
+                        continue;
+                }
+                if (!started ||
+                    (rec.kind != INPUTLOG_PORTS && rec.kind != INPUTLOG_END)) {
+                        fprintf(stderr, "Input log is corrupt\n");
+                        err = 1;
+                        break;
+                }
+                err = run_to(m, rec.cycle, s);
+                if (rec.kind == INPUTLOG_END) {
+                        s->hash = rec.hash;
+                        break;
+                }
+                m->pts.inp1.value = rec.inp1;
+                m->pts.inp2.value = rec.inp2;
+                ++s->events;
+        }
+        fclose(f);
+        return err;
+}
@@ -0,0 +1,48 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+// Input logs: what a live session did to the machine, cycle by cycle, so it
+// can be replayed bit for bit. Every time the input queue (inputq.h) applies
+// events, both input ports are logged with the machine cycle they changed
+// at. A state record holds a whole save state and restarts the log at its
+// cycle; the frontend writes one before it first runs and one after every
+// rewind. The end record holds the hash of the final save state, which
+// playback checks.
+//
+// File layout, host order: "SIIL" u16 version u16 reserved u64 rom hash,
+// then records of u64 cycle, u64 hash, u8 kind, u8 inp1, u8 inp2 and five
+// reserved bytes, a state record being followed by the save state.
+#define INPUTLOG_VERSION 1
+
+#define INPUTLOG_PORTS 1
+#define INPUTLOG_STATE 2
+#define INPUTLOG_END 3
+
+typedef struct {
+        FILE* f;
+        size_t events;
+} inputlog;
+
+typedef struct {
+        size_t events;
+        size_t states;
+        uint64_t cycles;  // run during playback
+        uint64_t hash;    // of the final state, as recorded
+} inputlog_summary;
+
+inputlog* inputlog_create(char const* path, rom const* r);
+int inputlog_state(inputlog* log, machine const* m);
+int inputlog_ports(inputlog* log, machine const* m);
+int inputlog_close(inputlog* log, machine const* m);
+uint64_t inputlog_hash(machine const* m);
+int inputlog_play(char const* path, rom const* r, machine* m,
+                  inputlog_summary* s);
+
+#endif
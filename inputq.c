@@ -0,0 +1,82 @@
+#include "inputq.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+
+void inputq_init(inputq* q, uint64_t min_hold) {
+        *q = (inputq){.min_hold = min_hold};
+}
+
+// keeps the queue ordered by cycle, equal cycles in arrival order
+static int insert(inputq* q, inputq_event e) {
+        if (q->n == INPUTQ_SIZE) {
+                fprintf(stderr, "Input queue full, dropping event\n");
+                return 1;
+        }
+        size_t i = q->n;
+        while (i > 0 && q->events[i - 1].cycle > e.cycle) {
+                q->events[i] = q->events[i - 1];
+                --i;
+        }
+        q->events[i] = e;
+        ++q->n;
+        return 0;
+}
+
+// Queues port (1 or 2) to become value at cycle, as one event per changed
+// bit. Returns non-zero if the queue overflowed.
+int inputq_set(inputq* q, uint64_t cycle, uint8_t port, uint8_t value) {
+        uint8_t* state = &q->state[port - 1];
+        uint8_t changed = *state ^ value;
+        int err = 0;
+        for (int bit = 0; bit < 8; ++bit) {
+                uint8_t mask = 1 << bit;
+                if (!(changed & mask)) {
+                        continue;
+                }
+                uint64_t* earliest = &q->earliest[port - 1][bit];
+                uint64_t at = cycle > *earliest ? cycle : *earliest;
+                inputq_event e = {
+                    .cycle = at, .port = port, .mask = mask, .value = value};
+                if (insert(q, e)) {
+                        err = 1;
+                        continue;
+                }
+                *earliest = at + q->min_hold;
+                *state ^= mask;
+        }
+        return err;
+}
+
+// The cycle of the next queued event, or limit if that comes first.
+uint64_t inputq_next(inputq const* q, uint64_t limit) {
+        if (q->n && q->events[0].cycle < limit) {
+                return q->events[0].cycle;
+        }
+        return limit;
+}
+
+// Applies every event due at or before the machine's current cycle.
+// Returns INPUTQ_APPLIED if there were any, with INPUTQ_PRESSED if one of
+// them set a bit.
+int inputq_apply(inputq* q, machine* m) {
+        size_t done = 0;
+        int result = 0;
+        while (done < q->n && q->events[done].cycle <= m->cycles) {
+                inputq_event const* e = &q->events[done++];
+                uint8_t* port =
+                    e->port == 1 ? &m->pts.inp1.value : &m->pts.inp2.value;
+                result |= INPUTQ_APPLIED;
+                if (e->value & e->mask & ~*port) {
+                        result |= INPUTQ_PRESSED;
+                }
+                *port = (*port & ~e->mask) | (e->value & e->mask);
+        }
+        q->n -= done;
+        memmove(q->events, q->events + done, q->n * sizeof(inputq_event));
+        return result;
+}
@@ -0,0 +1,45 @@
+#ifndef INPUTQ_H
+#define INPUTQ_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+
+#define INPUTQ_SIZE 64
+
+// what inputq_apply did
+#define INPUTQ_APPLIED 1  // applied at least one event
+#define INPUTQ_PRESSED 2  // set a bit that was clear
+
+// Input events stamped with the machine cycle (machine.cycles) at which
+// they take effect. The frontend converts host timestamps to cycles when it
+// queues an event and stops the machine at every queued cycle to apply it,
+// so an input lands at the same point of the emulation however the host
+// slices its run calls. The frontend can log the ports each time events
+// are applied (inputlog.h), and replaying that log reproduces the session.
+//
+// A bit of an input port never changes twice within min_hold cycles: a tap
+// shorter than that is stretched, and a second tap is delayed, so the game
+// sees every press however short it was on the host.
+typedef struct {
+        uint64_t cycle;
+        uint8_t port;  // 1 for inp1, 2 for inp2
+        uint8_t mask;
+        uint8_t value;
+} inputq_event;
+
+typedef struct {
+        inputq_event events[INPUTQ_SIZE];
+        size_t n;
+        uint64_t min_hold;
+        uint8_t state[2];          // both ports after every queued event
+        uint64_t earliest[2][8];   // first cycle each bit may change again
+} inputq;
+
+void inputq_init(inputq* q, uint64_t min_hold);
+int inputq_set(inputq* q, uint64_t cycle, uint8_t port, uint8_t value);
+uint64_t inputq_next(inputq const* q, uint64_t limit);
+int inputq_apply(inputq* q, machine* m);
+
+#endif
@@ -1,44 +1,128 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "audio.h"
-#include "cpu.h"
-#include "disassembler.h"
+#include "boot.h"
+#include "evdev.h"
+#include "frontend.h"
+#include "history.h"
+#include "inputlog.h"
+#include "inputq.h"
+#include "invaders.h"
+#include "latency.h"
+#include "machine.h"
 #include "ports.h"
-
-#define CPU_MEM 16384
-#define CYCLES_PER_INTERRUPT 16666
+#include "rom.h"
+#include "telemetry.h"
 
 #define SCREEN_WIDTH 224
 #define SCREEN_HEIGHT 256
 #define SCREEN_SCALE 2
 #define SCREEN_PADDING 40
 
+// room for roughly an hour of rewind
+#define HISTORY_SIZE (16 << 20)
+
+#define SPEED_MIN 0.25f
+#define SPEED_MAX 16.0f
+
+// most frames automatic frameskip drops in a row
+#define FRAMESKIP_AUTO_MAX 8
+
+// shortest press, and release, the game is guaranteed to see
+#define INPUT_HOLD_FRAMES 2
+
+#define WINDOW_TITLE "Space Invaders Emu"
+
+// the overlay's bars are full height at two 60 Hz frames
+#define OVERLAY_FRAME_NS 16666667ull
+#define OVERLAY_BAR_WIDTH 3
+
 static int const window_width =
     SCREEN_WIDTH * SCREEN_SCALE + SCREEN_PADDING * 2;
 static int const window_height =
     SCREEN_HEIGHT * SCREEN_SCALE + SCREEN_PADDING * 2;
 
-static int paused;
-
-static cpu* state;
-static ports* pts;
-
-static SDL_Window* window;
-static SDL_Renderer* renderer;
-
 static SDL_Color const color_grey = {.r = 0xbb, .g = 0xbb, .b = 0xbb};
 static SDL_Color const color_white = {.r = 0xff, .g = 0xff, .b = 0xff};
 static SDL_Color const color_red = {.r = 0xff, .g = 0x00, .b = 0x00};
 static SDL_Color const color_green = {.r = 0x00, .g = 0xff, .b = 0x00};
 static SDL_Color const color_cyan = {.r = 0x00, .g = 0xff, .b = 0xff};
 
-static clock_t lastTick;
-static size_t cycles_until_interrupt = CYCLES_PER_INTERRUPT;
-
-static uint8_t interrupt = 1;
+typedef struct {
+        SDL_Window* window;
+        SDL_Renderer* renderer;
+        rom* r;
+        machine* m;
+        frontend fe;
+        uint32_t lastTick;  // SDL's clock where the last update ran up to
+        int paused;
+        history* history;
+        size_t frame_cycles;
+        int rewinding;
+
+        // run-ahead: frames emulated past m on a scratch machine before
+        // every render, and the cpu time spent doing so
+        machine* ahead;
+        size_t run_ahead;
+        clock_t ahead_cost;
+        size_t ahead_renders;
+
+        // speed governor: a multiplier of real time, or uncapped, in which
+        // case sound is either muted or left at its natural pitch
+        float speed;
+        int uncapped;
+        int mute_fast;
+
+        // frameskip: vblanks dropped between renders, or
+        // INVADERS_FRAMESKIP_AUTO to drop them only while the host falls
+        // behind. frame holds the last vblank picked for rendering until
+        // it is drawn.
+        int frameskip;
+        size_t skipped;
+        int behind;
+        int pending;
+        uint64_t last_present;  // SDL performance counter
+        uint8_t frame[MACHINE_VRAM_SIZE];
+
+        // inputs as the host holds them, queued to reach the machine at
+        // the cycle matching their host time; the machine stood at cycle
+        // m->cycles when SDL's clock read lastTick
+        ports held;
+        inputq queue;
+
+        // optional log of the ports the queue applies, which needs a fresh
+        // save state whenever log_sync is set (see inputlog.h)
+        inputlog* log;
+        int log_sync;
+
+        // optional evdev controls, held on top of the keyboard
+        evdev* evdev;
+        uint8_t pad[2];
+
+        // SDL timestamps plus host_ticks are CLOCK_MONOTONIC milliseconds,
+        // the clock of evdev and latency timestamps
+        uint64_t host_ticks;
+
+        // optional input-to-photon latency probes, reported at quit
+        latency* latency;
+        char const* latency_path;
+
+        // frame-time telemetry, always on: drawn over the screen while
+        // overlay is set, and written to telemetry_path at quit. The mixer
+        // is called through timed sinks so that sound can be told apart
+        // from emulation.
+        telemetry telemetry;
+        int overlay;
+        char const* telemetry_path;
+        audio_sink mixer;
+        uint64_t audio_ns;
+} invaders;
+
+static invaders game;
 
 size_t get_screen_section(size_t row) {
         size_t section_size = SCREEN_HEIGHT / 8;
@@ -54,7 +138,7 @@ SDL_Color get_section_color(size_t section) {
         return colors[section % 8];
 }
 
-void render_screen(SDL_Renderer* renderer, cpu const* state) {
+void render_screen(SDL_Renderer* renderer, uint8_t const* vram) {
         SDL_Rect rect = {0};
         int x_offset = SCREEN_PADDING;
         int y_offset = SCREEN_PADDING;
@@ -72,8 +156,7 @@ void render_screen(SDL_Renderer* renderer, cpu const* state) {
                         }
 
                         for (size_t y = 0; y < SCREEN_WIDTH; ++y) {
-                                uint8_t d =
-                                    cpu_read(state, 32 * y + x + 0x2400);
+                                uint8_t d = vram[32 * y + x];
                                 if (d & (1 << b)) {
                                         rect.x =
                                             (i % SCREEN_WIDTH) * SCREEN_SCALE +
@@ -91,35 +174,76 @@ void render_screen(SDL_Renderer* renderer, cpu const* state) {
         }
 }
 
-uint8_t tick(cpu* state, ports* pts) {
-        uint8_t opcode = cpu_read(state, state->pc);
-        switch (opcode) {
-                case 0xdb:  // IN
-                {
-                        uint8_t port = cpu_read(state, state->pc + 1);
-                        state->a = ports_in(pts, port);
-                        state->pc += 2;
-                        return 10;
-                }
-                case 0xd3:  // OUT
-                {
-                        uint8_t port = cpu_read(state, state->pc + 1);
-                        ports_out(pts, port, state->a);
-                        state->pc += 2;
-                        return 10;
-                }
-                default: {
+// Sound is muted away from 1x if asked to; otherwise the samples keep
+// their pitch and are just triggered more or less often.
+static void update_audio(invaders* g) {
+        int mute = g->mute_fast && (g->uncapped || g->speed != 1.0f);
+        ports* pts = &g->m->pts;
+        if (mute && pts->audio.play) {
+                if (pts->prev_port_3 & 0x1) {
+                        pts->audio.stop(pts->audio.ctx, pts->ufo_channel);
+                }
+                pts->audio = (audio_sink){0};
+        } else if (!mute && !pts->audio.play) {
+                pts->audio = g->fe.audio;
+                // the UFO loop only starts on an edge of its port bit, so
+                // one that kept going while muted is restarted here
+                if ((pts->prev_port_3 & 0x1) && pts->audio.loop) {
+                        pts->ufo_channel =
+                            pts->audio.loop(pts->audio.ctx, SOUND_UFO);
                 }
         }
+}
 
-        size_t cycles = cpu_emulateOp(state);
-        return cycles;
+static void set_speed(invaders* g, float speed, int uncapped) {
+        if (speed < SPEED_MIN) {
+                speed = SPEED_MIN;
+        }
+        if (speed > SPEED_MAX) {
+                speed = SPEED_MAX;
+        }
+        g->speed = speed;
+        g->uncapped = uncapped;
+        update_audio(g);
+        if (uncapped) {
+                printf("speed: uncapped\n");
+        } else {
+                printf("speed: %gx\n", speed);
+        }
 }
 
-void keydown(SDL_KeyboardEvent key, cpu* state, ports* pts) {
+void keydown(SDL_KeyboardEvent key, invaders* g, ports* pts) {
         switch (key.keysym.sym) {
                 case SDLK_0: {
-                        paused = !paused;
+                        g->paused = !g->paused;
+                        break;
+                }
+                case SDLK_BACKSPACE: {
+                        g->rewinding = g->history != 0;
+                        break;
+                }
+                case SDLK_MINUS: {
+                        set_speed(g, g->speed / 2, 0);
+                        break;
+                }
+                case SDLK_EQUALS: {
+                        set_speed(g, g->speed * 2, 0);
+                        break;
+                }
+                case SDLK_t: {
+                        set_speed(g, g->speed, !g->uncapped);
+                        break;
+                }
+                case SDLK_m: {
+                        g->mute_fast = !g->mute_fast;
+                        update_audio(g);
+                        break;
+                }
+                case SDLK_F1: {
+                        g->overlay = !g->overlay;
+                        if (!g->overlay) {
+                                SDL_SetWindowTitle(g->window, WINDOW_TITLE);
+                        }
                         break;
                 }
                 case SDLK_RETURN: {
@@ -178,8 +302,14 @@ void keydown(SDL_KeyboardEvent key, cpu* state, ports* pts) {
         }
 }
 
-void keyup(SDL_KeyboardEvent key, ports* pts) {
+void keyup(SDL_KeyboardEvent key, invaders* g, ports* pts) {
         switch (key.keysym.sym) {
+                case SDLK_BACKSPACE: {
+                        // history_pop leaves the machine on a frame boundary
+                        g->rewinding = 0;
+                        g->frame_cycles = 0;
+                        break;
+                }
                 case SDLK_RETURN: {
                         pts->inp1.bits.credit = 0;
                         break;
@@ -236,63 +366,224 @@ void keyup(SDL_KeyboardEvent key, ports* pts) {
         }
 }
 
-size_t ncycles(clock_t lastTick) {
-        float elapsed = ((float)(clock() - lastTick)) / CLOCKS_PER_SEC;
-        return elapsed * 2000000;
+size_t ncycles(uint32_t elapsed_ms, float speed, size_t hz) {
+        return elapsed_ms / 1000.0 * speed * hz;
 }
 
-int invaders_init(FILE* f, size_t fsize) {
-        if (fsize > CPU_MEM) {
-                fprintf(stderr,
-                        "Provided file too big, wrong file or corrupted?\n");
-                return EXIT_FAILURE;
+// Keeps the current screen for the next render.
+static void latch(invaders* g) {
+        if (g->latency) {
+                latency_latch(g->latency);
         }
+        memcpy(g->frame, machine_vram(g->m), MACHINE_VRAM_SIZE);
+        g->pending = 1;
+}
 
-        state = cpu_new(CPU_MEM);
-        if (!state) {
-                fprintf(stderr, "Failed to initialize cpu state\n");
-                return EXIT_FAILURE;
+static int skip_frame(invaders* g) {
+        if (g->uncapped) {
+                // one frame per display refresh, however many were emulated
+                return SDL_GetPerformanceCounter() - g->last_present <
+                       SDL_GetPerformanceFrequency() / 60;
         }
-        fread(state->memory, fsize, 1, f);
+        if (g->frameskip == INVADERS_FRAMESKIP_AUTO) {
+                return g->behind && g->skipped < FRAMESKIP_AUTO_MAX;
+        }
+        return g->skipped < (size_t)g->frameskip;
+}
 
-        int err = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
-        if (err) {
-                fprintf(stderr, "Failed init SDL: %s\n", SDL_GetError());
-                return -1;
+// Called right after every vblank interrupt: records the machine in the
+// rewind history and picks the frame for rendering unless it is skipped, in
+// which case it costs no video work at all.
+static void vblank(invaders* g) {
+        if (g->history) {
+                history_push(g->history, g->m);
+        }
+        if (skip_frame(g)) {
+                ++g->skipped;
+                return;
         }
+        g->skipped = 0;
+        latch(g);
+}
 
-        window = SDL_CreateWindow("Space Invaders Emu", 100, 100, window_width,
-                                  window_height, SDL_WINDOW_SHOWN);
-        if (!window) {
-                fprintf(stderr, "Failed to create Window: %s\n",
-                        SDL_GetError());
-                return -1;
+// Stops logging after a write failed.
+static void drop_log(invaders* g) {
+        inputlog_close(g->log, g->m);
+        g->log = 0;
+}
+
+// Runs n cycles, stopping at every queued input and every vblank. Inputs
+// due by the last cycle are applied before it returns rather than at the
+// start of the next call, which is the same cycle but sooner.
+static void run(invaders* g, size_t n) {
+        uint64_t end = g->m->cycles + n;
+        if (g->log && g->log_sync) {
+                g->log_sync = 0;
+                if (inputlog_state(g->log, g->m)) {
+                        drop_log(g);
+                }
         }
+        for (;;) {
+                uint8_t inp1 = g->m->pts.inp1.value;
+                uint8_t inp2 = g->m->pts.inp2.value;
+                int applied = inputq_apply(&g->queue, g->m);
+                if ((applied & INPUTQ_PRESSED) && g->latency &&
+                    latency_wants_port(g->latency)) {
+                        latency_port(g->latency, g->m, inp1, inp2);
+                }
+                if ((applied & INPUTQ_APPLIED) && g->log &&
+                    inputlog_ports(g->log, g->m)) {
+                        drop_log(g);
+                }
+                if (g->m->cycles >= end) {
+                        break;
+                }
+                uint64_t stop = inputq_next(&g->queue, end);
+                size_t vblanks = g->m->vblanks;
+                machine_run_to_vblank(g->m, stop - g->m->cycles);
+                if (g->latency) {
+                        latency_run(g->latency, g->m);
+                }
+                if (g->m->vblanks != vblanks) {
+                        vblank(g);
+                }
+        }
+}
 
-        renderer = SDL_CreateRenderer(
-            window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-        if (!renderer) {
-                fprintf(stderr, "Failed to create renderer: %s\n",
-                        SDL_GetError());
-                return -1;
+// Steps back one frame per frame of elapsed time. The inputs stay those
+// currently held rather than the recorded ones.
+static void rewind_frames(invaders* g, size_t n) {
+        g->frame_cycles += n;
+        for (; g->frame_cycles >= machine_frame_cycles(g->m);
+             g->frame_cycles -= machine_frame_cycles(g->m)) {
+                ports_inp1 inp1 = g->m->pts.inp1;
+                ports_inp2 inp2 = g->m->pts.inp2;
+                history_pop(g->history, g->m);
+                g->m->pts.inp1 = inp1;
+                g->m->pts.inp2 = inp2;
+                g->log_sync = 1;
+                if (g->latency) {
+                        latency_rewind(g->latency);
+                }
+                latch(g);
         }
+}
 
-        pts = ports_new();
+// Busy time of the latest frames as bars along the bottom padding, red when
+// over a 60 Hz frame, which the line marks.
+static void render_overlay(invaders* g) {
+        telemetry const* t = &g->telemetry;
+        int bottom = window_height - SCREEN_PADDING / 8;
+        int height = SCREEN_PADDING * 3 / 4;
+        int right = SCREEN_PADDING + TELEMETRY_RECENT * OVERLAY_BAR_WIDTH;
+        for (size_t i = 0; i < TELEMETRY_RECENT; ++i) {
+                size_t slot = (t->recent_next + i) % TELEMETRY_RECENT;
+                uint64_t ns = t->recent[slot];
+                SDL_Color color =
+                    ns > OVERLAY_FRAME_NS ? color_red : color_green;
+                SDL_SetRenderDrawColor(g->renderer, color.r, color.g, color.b,
+                                       255);
+                int h = ns < 2 * OVERLAY_FRAME_NS
+                            ? ns * height / (2 * OVERLAY_FRAME_NS)
+                            : height;
+                SDL_Rect bar = {
+                    .x = SCREEN_PADDING + i * OVERLAY_BAR_WIDTH,
+                    .y = bottom - h,
+                    .w = OVERLAY_BAR_WIDTH,
+                    .h = h,
+                };
+                SDL_RenderFillRect(g->renderer, &bar);
+        }
+        SDL_SetRenderDrawColor(g->renderer, color_grey.r, color_grey.g,
+                               color_grey.b, 255);
+        SDL_RenderDrawLine(g->renderer, SCREEN_PADDING, bottom - height / 2,
+                           right, bottom - height / 2);
+}
 
-        audio_init();
-        lastTick = clock();
+// Shows the rates and the worst phase times in the window title.
+static void update_title(invaders* g) {
+        telemetry const* t = &g->telemetry;
+        char title[160];
+        snprintf(title, sizeof(title),
+                 WINDOW_TITLE " - %.1f fps, %.1f emulated fps, %.2f MIPS, "
+                              "p99 update %.2f ms, render %.2f ms",
+                 t->fps, t->emulated_fps, t->mips,
+                 telemetry_percentile(&t->phases[TELEMETRY_UPDATE], 0.99) /
+                     1e6,
+                 telemetry_percentile(&t->phases[TELEMETRY_RENDER], 0.99) /
+                     1e6);
+        SDL_SetWindowTitle(g->window, title);
+}
 
-        return 0;
+void sdl_present(void* ctx, uint8_t const* vram) {
+        invaders* g = ctx;
+        uint64_t start = telemetry_now_ns();
+        SDL_SetRenderDrawColor(g->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(g->renderer);
+        render_screen(g->renderer, vram);
+        if (g->overlay) {
+                render_overlay(g);
+        }
+        if (g->latency) {
+                latency_convert(g->latency);
+        }
+        uint64_t converted = telemetry_now_ns();
+        SDL_RenderPresent(g->renderer);
+        if (g->latency) {
+                latency_present(g->latency);
+        }
+        telemetry_record(&g->telemetry, TELEMETRY_CONVERT, converted - start);
+        telemetry_record(&g->telemetry, TELEMETRY_PRESENT,
+                         telemetry_now_ns() - converted);
 }
 
-void invaders_render() {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        render_screen(renderer, state);
-        SDL_RenderPresent(renderer);
+static void timed_play(void* ctx, audio_sound sound) {
+        invaders* g = ctx;
+        uint64_t start = telemetry_now_ns();
+        g->mixer.play(g->mixer.ctx, sound);
+        g->audio_ns += telemetry_now_ns() - start;
 }
 
-int invaders_update() {
+static int timed_loop(void* ctx, audio_sound sound) {
+        invaders* g = ctx;
+        uint64_t start = telemetry_now_ns();
+        int channel = g->mixer.loop(g->mixer.ctx, sound);
+        g->audio_ns += telemetry_now_ns() - start;
+        return channel;
+}
+
+static void timed_stop(void* ctx, int channel) {
+        invaders* g = ctx;
+        uint64_t start = telemetry_now_ns();
+        g->mixer.stop(g->mixer.ctx, channel);
+        g->audio_ns += telemetry_now_ns() - start;
+}
+
+// Queues the held inputs for the cycle that corresponds to the host time of
+// an event. Events are polled before the batch that covers their host time
+// is run, so they land inside that batch at their relative position.
+static void queue_input(invaders* g, uint32_t timestamp) {
+        uint8_t inp1 = g->held.inp1.value | g->pad[0];
+        uint8_t inp2 = g->held.inp2.value | g->pad[1];
+        if (g->latency &&
+            ((inp1 & ~g->queue.state[0]) | (inp2 & ~g->queue.state[1]))) {
+                // only presses: the game may well not react to a release
+                latency_event(g->latency, (timestamp + g->host_ticks) * 1000);
+        }
+
+        uint64_t cycle = g->m->cycles;
+        if (!g->uncapped && timestamp > g->lastTick) {
+                cycle += (uint64_t)(timestamp - g->lastTick) * g->speed *
+                         machine_clock(g->m) / 1000;
+        }
+        inputq_set(&g->queue, cycle, 1, inp1);
+        inputq_set(&g->queue, cycle, 2, inp2);
+}
+
+// Collects key changes into the held inputs and queues them; the ports
+// themselves are only written by run.
+int sdl_poll(void* ctx, ports* pts) {
+        invaders* g = ctx;
         SDL_Event e = {0};
         while (SDL_PollEvent(&e)) {
                 switch (e.type) {
@@ -301,11 +592,13 @@ int invaders_update() {
                                 break;
                         }
                         case SDL_KEYDOWN: {
-                                keydown(e.key, state, pts);
+                                keydown(e.key, g, &g->held);
+                                queue_input(g, e.key.timestamp);
                                 break;
                         }
                         case SDL_KEYUP: {
-                                keyup(e.key, pts);
+                                keyup(e.key, g, &g->held);
+                                queue_input(g, e.key.timestamp);
                                 break;
                         }
                         default: {
@@ -314,45 +607,281 @@ int invaders_update() {
                 }
         }
 
-        if (paused) {
-                // prevent fast-forwarding
-                lastTick = clock();
-                return 0;
+        evdev_event ev;
+        while (g->evdev && evdev_next(g->evdev, &ev)) {
+                g->pad[0] = ev.inp1;
+                g->pad[1] = ev.inp2;
+                queue_input(g, ev.ms - g->host_ticks);
+        }
+        return 0;
+}
+
+int invaders_init(FILE* f, size_t fsize) {
+        game.r = rom_read(f, fsize);
+        if (!game.r) {
+                return EXIT_FAILURE;
+        }
+        game.m = machine_new(game.r, (audio_sink){0});
+        if (!game.m) {
+                return EXIT_FAILURE;
+        }
+        game.history = history_new(HISTORY_SIZE);
+        if (!game.history) {
+                fprintf(stderr, "Rewind is disabled\n");
         }
 
-        size_t n = ncycles(lastTick);
-        while (n) {
-                size_t cycles = tick(state, pts);
-                if (state->int_enable) {
-                        if (cycles > cycles_until_interrupt) {
-                                cpu_interrupt(state, interrupt);
-                                interrupt = interrupt == 1 ? 2 : 1;
-                                cycles_until_interrupt = CYCLES_PER_INTERRUPT;
-                        } else {
-                                cycles_until_interrupt -= cycles;
-                        }
-                }
+        int err = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+        if (err) {
+                fprintf(stderr, "Failed init SDL: %s\n", SDL_GetError());
+                return -1;
+        }
 
-                if (cycles > n) {
-                        break;
+        game.window =
+            SDL_CreateWindow(WINDOW_TITLE, 100, 100, window_width,
+                             window_height, SDL_WINDOW_SHOWN);
+        if (!game.window) {
+                fprintf(stderr, "Failed to create Window: %s\n",
+                        SDL_GetError());
+                return -1;
+        }
+
+        game.renderer = SDL_CreateRenderer(
+            game.window, -1,
+            SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        if (!game.renderer) {
+                fprintf(stderr, "Failed to create renderer: %s\n",
+                        SDL_GetError());
+                return -1;
+        }
+
+        game.mixer = audio_mixer_sink();
+        game.fe = (frontend){
+            .video = {.ctx = &game, .present = sdl_present},
+            .audio = {.ctx = &game,
+                      .play = timed_play,
+                      .loop = timed_loop,
+                      .stop = timed_stop},
+            .input = {.ctx = &game, .poll = sdl_poll},
+        };
+        game.m->pts.audio = game.fe.audio;
+        telemetry_init(&game.telemetry);
+
+        audio_init();
+        game.speed = 1.0f;
+        inputq_init(&game.queue,
+                    INPUT_HOLD_FRAMES * machine_frame_cycles(game.m));
+        game.lastTick = SDL_GetTicks();
+        game.host_ticks = latency_now_us() / 1000 - game.lastTick;
+
+        return 0;
+}
+
+// Presents what the screen will show run_ahead frames from now if the
+// inputs held now stay held, which hides that many frames of the game's own
+// input lag. The copy runs to its run_ahead-th vblank, so like the latched
+// frames it is shown whole. m itself is never touched, so nothing has to be
+// restored.
+static uint8_t const* run_ahead(invaders* g) {
+        clock_t start = clock();
+        machine_clone(g->ahead, g->m);
+        for (size_t i = 0; i < g->run_ahead; ++i) {
+                // bounded in case the game runs with interrupts disabled
+                machine_run_to_vblank(g->ahead,
+                                      2 * machine_frame_cycles(g->ahead));
+        }
+        g->ahead_cost += clock() - start;
+        if (g->latency) {
+                latency_ahead(g->latency, g->ahead);
+        }
+
+        if (++g->ahead_renders == 600) {
+                double us = 1e6 * g->ahead_cost / CLOCKS_PER_SEC / 600;
+                printf("run-ahead %zu: %.0fus extra per frame (%.1f%% of a "
+                       "frame)\n",
+                       g->run_ahead, us, us * 60 / 1e4);
+                g->ahead_cost = 0;
+                g->ahead_renders = 0;
+        }
+        return machine_vram(g->ahead);
+}
+
+int invaders_set_run_ahead(size_t frames) {
+        if (frames && !game.ahead) {
+                game.ahead = machine_new(game.r, (audio_sink){0});
+                if (!game.ahead) {
+                        return 1;
                 }
-                n -= cycles;
         }
-        lastTick = clock();
+        game.run_ahead = frames;
+        game.ahead_cost = 0;
+        game.ahead_renders = 0;
+        return 0;
+}
 
+// Skips the ROM's power-on sequence by loading its post-boot snapshot from
+// dir, creating it there first if needed.
+int invaders_fast_boot(char const* dir) {
+        size_t hz = machine_clock(game.m);
+        if (boot_machine(game.m, game.r, dir)) {
+                return 1;
+        }
+        machine_set_clock(game.m, hz);
+        if (game.history) {
+                history_clear(game.history);
+        }
+        game.frame_cycles = 0;
+        latch(&game);
+        return 0;
+}
+
+// speed is a multiplier of real time between 0.25 and 16, or 0 to run
+// uncapped. mute_fast mutes the sound whenever the speed is not 1x.
+void invaders_set_speed(float speed, int mute_fast) {
+        game.mute_fast = mute_fast;
+        set_speed(&game, speed ? speed : game.speed, speed == 0);
+}
+
+// Reads the controls from evdev devices on a thread of their own, as
+// described by config (see evdev.h), in addition to the keyboard.
+int invaders_use_evdev(char const* config) {
+        game.evdev = evdev_open(config);
+        if (!game.evdev) {
+                return 1;
+        }
+        return 0;
+}
+
+// Whether input is waiting that should be taken in by an update now rather
+// than at the next tick.
+int invaders_input_pending() {
+        return game.evdev && evdev_pending(game.evdev);
+}
+
+// Writes the frame-time telemetry to path as JSON at quit (see
+// telemetry.h). F1 shows it over the game at any time.
+void invaders_write_telemetry(char const* path) {
+        game.telemetry_path = path;
+}
+
+// Measures the latency from input events to the screen (see latency.h) and
+// writes the histograms to path at quit.
+int invaders_measure_latency(char const* path) {
+        game.latency = latency_new(game.r);
+        if (!game.latency) {
+                return 1;
+        }
+        game.latency_path = path;
+        return 0;
+}
+
+// Logs every change the input queue makes to the ports to path, so that
+// replay can play the session back (see inputlog.h).
+int invaders_record_input(char const* path) {
+        game.log = inputlog_create(path, game.r);
+        if (!game.log) {
+                return 1;
+        }
+        game.log_sync = 1;
+        return 0;
+}
+
+// Runs the cpu at hz. The game keeps running at 60 frames per second but
+// gets hz / 60 cycles for each of them.
+void invaders_set_clock(size_t hz) {
+        machine_set_clock(game.m, hz);
+        game.queue.min_hold = INPUT_HOLD_FRAMES * machine_frame_cycles(game.m);
+        printf("cpu clock: %zu Hz\n", machine_clock(game.m));
+}
+
+// n is the number of vblanks to drop between renders, or
+// INVADERS_FRAMESKIP_AUTO.
+void invaders_set_frameskip(int n) {
+        game.frameskip = n;
+        game.skipped = 0;
+}
+
+// Draws the frame picked at the last vblank, if it has not been drawn yet.
+void invaders_render() {
+        if (!game.pending) {
+                return;
+        }
+        uint64_t start = telemetry_now_ns();
+        game.pending = 0;
+        game.last_present = SDL_GetPerformanceCounter();
+        uint8_t const* vram = game.run_ahead ? run_ahead(&game) : game.frame;
+        game.fe.video.present(game.fe.video.ctx, vram);
+        telemetry_record(&game.telemetry, TELEMETRY_RENDER,
+                         telemetry_now_ns() - start);
+}
+
+int invaders_update() {
+        uint64_t start = telemetry_now_ns();
+        if (game.fe.input.poll(game.fe.input.ctx, &game.m->pts)) {
+                return 1;
+        }
+        uint64_t polled = telemetry_now_ns();
+        game.audio_ns = 0;
+
+        // the one clock both the batch and the queued inputs are timed by
+        uint32_t now = SDL_GetTicks();
+        if (game.paused) {
+                // prevent fast-forwarding
+                game.lastTick = now;
+                return 0;
+        }
+
+        if (game.rewinding) {
+                rewind_frames(&game, ncycles(now - game.lastTick, 1.0f,
+                                             machine_clock(game.m)));
+        } else if (game.uncapped) {
+                // whole frames for one update period; only the frames that
+                // end when a display refresh is due are rendered
+                uint64_t start = SDL_GetPerformanceCounter();
+                uint64_t period = SDL_GetPerformanceFrequency() / 120;
+                do {
+                        run(&game, machine_frame_cycles(game.m));
+                } while (SDL_GetPerformanceCounter() - start < period);
+        } else {
+                size_t n = ncycles(now - game.lastTick, game.speed,
+                                   machine_clock(game.m));
+                game.behind = n > machine_frame_cycles(game.m);
+                run(&game, n);
+        }
+        game.lastTick = now;
+
+        uint64_t end = telemetry_now_ns();
+        telemetry* t = &game.telemetry;
+        telemetry_record(t, TELEMETRY_POLL, polled - start);
+        telemetry_record(t, TELEMETRY_EMULATE, end - polled - game.audio_ns);
+        telemetry_record(t, TELEMETRY_AUDIO, game.audio_ns);
+        telemetry_record(t, TELEMETRY_UPDATE, end - start);
+        if (telemetry_sample(t, game.m) && game.overlay) {
+                update_title(&game);
+        }
         return 0;
 }
 
 void invaders_quit() {
         printf("Cleaning up...\n");
-        ports_delete(pts);
-        cpu_delete(state);
+        if (game.telemetry_path) {
+                telemetry_write(&game.telemetry, game.telemetry_path);
+        }
+        if (game.latency) {
+                latency_write(game.latency, game.latency_path);
+                latency_delete(game.latency);
+        }
+        inputlog_close(game.log, game.m);
+        evdev_close(game.evdev);
+        history_delete(game.history);
+        machine_delete(game.ahead);
+        machine_delete(game.m);
+        rom_close(game.r);
         audio_quit();
-        if (window) {
-                SDL_DestroyWindow(window);
+        if (game.window) {
+                SDL_DestroyWindow(game.window);
         }
-        if (renderer) {
-                SDL_DestroyRenderer(renderer);
+        if (game.renderer) {
+                SDL_DestroyRenderer(game.renderer);
         }
         SDL_Quit();
 }
@@ -3,8 +3,24 @@
 
 #include <stdio.h>
 
+#define INVADERS_FRAMESKIP_AUTO -1
+#define INVADERS_FRAMESKIP_MAX 30  // frames --frameskip N may drop per draw
+
+// most frames run-ahead can look past the live machine
+#define INVADERS_RUN_AHEAD_MAX 10
+
 int invaders_init(FILE* f, size_t fsize);
+int invaders_fast_boot(char const* dir);
+int invaders_set_run_ahead(size_t frames);
+void invaders_set_speed(float speed, int mute_fast);
+void invaders_set_frameskip(int n);
+void invaders_set_clock(size_t hz);
+int invaders_use_evdev(char const* config);
+int invaders_measure_latency(char const* path);
+int invaders_record_input(char const* path);
+void invaders_write_telemetry(char const* path);
 void invaders_render();
+int invaders_input_pending();
 int invaders_update();
 void invaders_quit();
 
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "latency.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "machine.h"
+
+static char const* const stage_names[LATENCY_STAGES] = {
+    "event", "port", "vram", "convert", "present",
+};
+
+latency* latency_new(rom const* r) {
+        latency* l = calloc(1, sizeof(latency));
+        if (!l) {
+                return 0;
+        }
+        l->shadow = machine_new(r, (audio_sink){0});
+        l->shadow_ahead = machine_new(r, (audio_sink){0});
+        if (!l->shadow || !l->shadow_ahead) {
+                latency_delete(l);
+                return 0;
+        }
+        return l;
+}
+
+void latency_delete(latency* l) {
+        if (!l) {
+                return;
+        }
+        machine_delete(l->shadow);
+        machine_delete(l->shadow_ahead);
+        free(l);
+}
+
+uint64_t latency_now_us() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void mark(latency* l, latency_stage stage, uint64_t us) {
+        l->t[stage] = us;
+        l->next = stage + 1;
+}
+
+// Starts a probe for an input the host received at us.
+void latency_event(latency* l, uint64_t us) {
+        if (l->next == LATENCY_PORT &&
+            us - l->t[LATENCY_EVENT] >
+                LATENCY_TIMEOUT_FRAMES * 1000000ull / 60) {
+                // its press never reached the port, say from a full queue
+                ++l->dropped;
+                l->next = LATENCY_EVENT;
+        }
+        if (l->next == LATENCY_EVENT) {
+                l->latched = 0;
+                mark(l, LATENCY_EVENT, us);
+        }
+}
+
+int latency_wants_port(latency const* l) { return l->next == LATENCY_PORT; }
+
+// Call right after a press was written to m's ports, which held inp1 and
+// inp2 before. The shadow carries on from there with those.
+void latency_port(latency* l, machine const* m, uint8_t inp1, uint8_t inp2) {
+        machine_clone(l->shadow, m);
+        l->shadow->pts.inp1.value = inp1;
+        l->shadow->pts.inp2.value = inp2;
+        l->port_cycle = m->cycles;
+        mark(l, LATENCY_PORT, latency_now_us());
+}
+
+// Call whenever m has run: brings the shadow to the same cycle and looks
+// for the first difference the input made.
+void latency_run(latency* l, machine const* m) {
+        if (l->next != LATENCY_VRAM) {
+                return;
+        }
+        while (l->shadow->cycles < m->cycles) {
+                machine_step(l->shadow);
+        }
+        if (memcmp(machine_vram(l->shadow), machine_vram(m),
+                   MACHINE_VRAM_SIZE)) {
+                mark(l, LATENCY_VRAM, latency_now_us());
+        } else if (m->cycles - l->port_cycle >
+                   LATENCY_TIMEOUT_FRAMES * machine_frame_cycles(m)) {
+                ++l->dropped;
+                l->next = LATENCY_EVENT;
+        }
+}
+
+// Call when m is rewound: the shadow and any frame already picked no longer
+// follow from the probe's input.
+void latency_rewind(latency* l) {
+        if (l->next > LATENCY_PORT) {
+                ++l->dropped;
+                l->next = LATENCY_EVENT;
+        }
+}
+
+// With run-ahead the screen shows ahead, some frames past the live machine.
+// The response is then whatever ahead shows that the shadow, run as far
+// ahead, does not, and the frame being shown is the one that has it.
+void latency_ahead(latency* l, machine const* ahead) {
+        if (l->next != LATENCY_VRAM) {
+                return;
+        }
+        machine_clone(l->shadow_ahead, l->shadow);
+        while (l->shadow_ahead->cycles < ahead->cycles) {
+                machine_step(l->shadow_ahead);
+        }
+        if (memcmp(machine_vram(l->shadow_ahead), machine_vram(ahead),
+                   MACHINE_VRAM_SIZE)) {
+                mark(l, LATENCY_VRAM, latency_now_us());
+                l->latched = 1;
+        }
+}
+
+// Call when a frame is picked for display.
+void latency_latch(latency* l) {
+        if (l->next == LATENCY_CONVERT) {
+                l->latched = 1;
+        }
+}
+
+// Call when the picked frame has been converted for display.
+void latency_convert(latency* l) {
+        if (l->next == LATENCY_CONVERT && l->latched) {
+                mark(l, LATENCY_CONVERT, latency_now_us());
+        }
+}
+
+static void add(latency_histogram* h, uint64_t us) {
+        size_t bucket = us / LATENCY_BUCKET_US;
+        ++h->counts[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS];
+        ++h->n;
+        h->sum_us += us;
+        if (us > h->max_us) {
+                h->max_us = us;
+        }
+}
+
+// Call when the display call for the converted frame has returned; this
+// completes the probe.
+void latency_present(latency* l) {
+        if (l->next != LATENCY_PRESENT) {
+                return;
+        }
+        mark(l, LATENCY_PRESENT, latency_now_us());
+        for (int s = LATENCY_PORT; s < LATENCY_STAGES; ++s) {
+                uint64_t t0 = l->t[LATENCY_EVENT];
+                add(&l->stages[s], l->t[s] > t0 ? l->t[s] - t0 : 0);
+        }
+        l->next = LATENCY_EVENT;
+}
+
+static uint64_t percentile(latency_histogram const* h, double p) {
+        uint64_t rank = h->n * p;
+        uint64_t seen = 0;
+        for (size_t i = 0; i <= LATENCY_BUCKETS; ++i) {
+                seen += h->counts[i];
+                if (seen > rank) {
+                        return i < LATENCY_BUCKETS ? (i + 1) * LATENCY_BUCKET_US
+                                                   : h->max_us;
+                }
+        }
+        return h->max_us;
+}
+
+// Writes a summary line per stage followed by the histograms, one row per
+// LATENCY_BUCKET_US bucket (upper bound in us) and one column per stage.
+int latency_write(latency const* l, char const* path) {
+        FILE* f = fopen(path, "w");
+        if (!f) {
+                fprintf(stderr, "Failed to open latency report: %s\n", path);
+                return 1;
+        }
+
+        uint64_t n = l->stages[LATENCY_PRESENT].n;
+        fprintf(f, "# %llu probes, %llu dropped without a response\n",
+                (unsigned long long)n, (unsigned long long)l->dropped);
+        fprintf(f, "# stage mean_us p50_us p90_us p99_us max_us\n");
+        for (int s = LATENCY_PORT; s < LATENCY_STAGES; ++s) {
+                latency_histogram const* h = &l->stages[s];
+                fprintf(f, "# %s %llu %llu %llu %llu %llu\n", stage_names[s],
+                        (unsigned long long)(h->n ? h->sum_us / h->n : 0),
+                        (unsigned long long)percentile(h, 0.5),
+                        (unsigned long long)percentile(h, 0.9),
+                        (unsigned long long)percentile(h, 0.99),
+                        (unsigned long long)h->max_us);
+        }
+
+        fprintf(f, "upper_us");
+        for (int s = LATENCY_PORT; s < LATENCY_STAGES; ++s) {
+                fprintf(f, " %s", stage_names[s]);
+        }
+        fprintf(f, "\n");
+        for (size_t i = 0; i <= LATENCY_BUCKETS; ++i) {
+                uint64_t any = 0;
+                for (int s = LATENCY_PORT; s < LATENCY_STAGES; ++s) {
+                        any |= l->stages[s].counts[i];
+                }
+                if (!any) {
+                        continue;
+                }
+                if (i < LATENCY_BUCKETS) {
+                        fprintf(f, "%zu", (i + 1) * LATENCY_BUCKET_US);
+                } else {
+                        fprintf(f, "inf");
+                }
+                for (int s = LATENCY_PORT; s < LATENCY_STAGES; ++s) {
+                        fprintf(f, " %llu",
+                                (unsigned long long)l->stages[s].counts[i]);
+                }
+                fprintf(f, "\n");
+        }
+
+        if (fclose(f)) {
+                fprintf(stderr, "Failed to write latency report: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
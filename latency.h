@@ -0,0 +1,75 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+// Input-to-photon latency probes. A probe starts when the host receives an
+// input event while no other probe is in flight and records the host time
+// (CLOCK_MONOTONIC, in us) of each stage on the way to the screen:
+//
+//     event    the host received the input
+//     port     the emulation wrote it to the input port
+//     vram     the game first drew something because of it
+//     convert  the first frame showing that was converted for display
+//     present  the display call for that frame returned
+//
+// The response is found by running a shadow machine from the moment of the
+// port write with the old inputs and watching for the first video RAM
+// difference, so it is exact whatever the game does with the input.
+// Inputs the game does not react to within LATENCY_TIMEOUT_FRAMES, or that
+// do not reach the port within as long, are dropped, and so are probes
+// that a rewind overtakes. Every stage keeps a histogram of its time since
+// the event.
+#define LATENCY_BUCKET_US 500
+#define LATENCY_BUCKETS 400
+#define LATENCY_TIMEOUT_FRAMES 30
+
+typedef enum {
+        LATENCY_EVENT,
+        LATENCY_PORT,
+        LATENCY_VRAM,
+        LATENCY_CONVERT,
+        LATENCY_PRESENT,
+        LATENCY_STAGES
+} latency_stage;
+
+typedef struct {
+        uint64_t counts[LATENCY_BUCKETS + 1];  // the last one is overflow
+        uint64_t n;
+        uint64_t sum_us;
+        uint64_t max_us;
+} latency_histogram;
+
+typedef struct {
+        // stage the in-flight probe waits for, LATENCY_EVENT when idle
+        latency_stage next;
+        int latched;
+        uint64_t t[LATENCY_STAGES];
+        uint64_t port_cycle;
+        machine* shadow;
+        machine* shadow_ahead;
+
+        latency_histogram stages[LATENCY_STAGES];
+        uint64_t dropped;
+} latency;
+
+latency* latency_new(rom const* r);
+void latency_delete(latency* l);
+uint64_t latency_now_us();
+
+void latency_event(latency* l, uint64_t us);
+int latency_wants_port(latency const* l);
+void latency_port(latency* l, machine const* m, uint8_t inp1, uint8_t inp2);
+void latency_run(latency* l, machine const* m);
+void latency_rewind(latency* l);
+void latency_ahead(latency* l, machine const* ahead);
+void latency_latch(latency* l);
+void latency_convert(latency* l);
+void latency_present(latency* l);
+int latency_write(latency const* l, char const* path);
+
+#endif
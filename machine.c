@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "machine.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "opstats.h"
+#include "ports.h"
+#include "rom.h"
+
+static uint8_t tick(cpu* state, ports* pts) {
+        uint8_t opcode = cpu_read(state, state->pc);
+        switch (opcode) {
+                case 0xdb:  // IN
+                {
+                        uint8_t port = cpu_read(state, state->pc + 1);
+                        state->a = ports_in(pts, port);
+                        state->pc += 2;
+                        OPSTATS_OP(opcode, 10);
+                        return 10;
+                }
+                case 0xd3:  // OUT
+                {
+                        uint8_t port = cpu_read(state, state->pc + 1);
+                        ports_out(pts, port, state->a);
+                        state->pc += 2;
+                        OPSTATS_OP(opcode, 10);
+                        return 10;
+                }
+                default: {
+                }
+        }
+
+        // cpu_emulateOp fetches the opcode again
+        OPSTATS_UNREAD(opstats_region_of(state->pc));
+        size_t cycles = cpu_emulateOp(state);
+        return cycles;
+}
+
+// Puts a machine into its power-on state in place, without allocating. The
+// rom must outlive the machine.
+void machine_init(machine* m, rom const* r, audio_sink audio) {
+        memset(m, 0, sizeof(machine));
+        m->cpu.rom = r ? r->data : 0;
+        m->cpu.memory = m->memory;
+        m->pts.audio = audio;
+        m->cycles_per_interrupt = MACHINE_CYCLES_PER_INTERRUPT;
+        m->cycles_until_interrupt = MACHINE_CYCLES_PER_INTERRUPT;
+        m->interrupt = 1;
+}
+
+machine* machine_new(rom const* r, audio_sink audio) {
+        void* block = 0;
+        if (posix_memalign(&block, MACHINE_ALIGN, sizeof(machine))) {
+                fprintf(stderr, "Failed to allocate machine\n");
+                return 0;
+        }
+
+        machine* m = block;
+        machine_init(m, r, audio);
+        return m;
+}
+
+void machine_delete(machine* m) { free(m); }
+
+// Makes m an exact copy of image, e.g. a pristine power-on machine or an
+// earlier copy of m itself.
+void machine_reset(machine* m, machine const* image) {
+        memcpy(m, image, sizeof(machine));
+        m->cpu.memory = m->memory;
+}
+
+// Copies the complete state of src into the pre-allocated dst. Unlike
+// machine_reset, dst keeps its own audio sink so clones used to look ahead
+// stay silent.
+void machine_clone(machine* dst, machine const* src) {
+        audio_sink audio = dst->pts.audio;
+        machine_reset(dst, src);
+        dst->pts.audio = audio;
+}
+
+// Overclocks (or underclocks) the cpu to hz while keeping the interrupts,
+// and with them the game's frame rate, at 60 Hz. The game then gets more
+// cycles per frame to draw in, which removes its slowdown.
+void machine_set_clock(machine* m, size_t hz) {
+        size_t n = hz / MACHINE_INTERRUPT_HZ;
+        m->cycles_per_interrupt = n ? n : 1;
+        if (m->cycles_until_interrupt > m->cycles_per_interrupt) {
+                m->cycles_until_interrupt = m->cycles_per_interrupt;
+        }
+}
+
+size_t machine_clock(machine const* m) {
+        return m->cycles_per_interrupt * MACHINE_INTERRUPT_HZ;
+}
+
+// Cycles from one vblank to the next at the machine's clock.
+size_t machine_frame_cycles(machine const* m) {
+        return 2 * m->cycles_per_interrupt;
+}
+
+// Executes one instruction and returns the cycles it took.
+size_t machine_step(machine* m) {
+        size_t cycles = tick(&m->cpu, &m->pts);
+        m->cycles += cycles;
+        ++m->instructions;
+        if (m->cpu.int_enable) {
+                if (cycles > m->cycles_until_interrupt) {
+                        cpu_interrupt(&m->cpu, m->interrupt);
+                        m->vblanks += m->interrupt == 2;
+                        m->interrupt = m->interrupt == 1 ? 2 : 1;
+                        m->cycles_until_interrupt = m->cycles_per_interrupt;
+                } else {
+                        m->cycles_until_interrupt -= cycles;
+                }
+        }
+        return cycles;
+}
+
+void machine_run(machine* m, size_t n) {
+        while (n) {
+                size_t cycles = machine_step(m);
+                if (cycles > n) {
+                        break;
+                }
+                n -= cycles;
+        }
+}
+
+// Like machine_run, but returns right after the next vblank interrupt if
+// that comes within n cycles. Returns the cycles run, at most n.
+size_t machine_run_to_vblank(machine* m, size_t n) {
+        size_t vblanks = m->vblanks;
+        size_t run = 0;
+        while (run < n && m->vblanks == vblanks) {
+                run += machine_step(m);
+        }
+        return run < n ? run : n;
+}
+
+uint8_t const* machine_vram(machine const* m) {
+        return m->memory + (MACHINE_VRAM - CPU_RAM_START);
+}
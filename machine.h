@@ -0,0 +1,65 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "audio.h"
+#include "cpu.h"
+#include "ports.h"
+#include "rom.h"
+
+// The stock 2 MHz clock. The cpu clock can be changed per machine with
+// machine_set_clock; the interrupts always come at 120 Hz, two per frame.
+#define MACHINE_CLOCK_HZ 2000000
+#define MACHINE_INTERRUPT_HZ 120
+#define MACHINE_CYCLES_PER_INTERRUPT 16666
+#define MACHINE_CYCLES_PER_FRAME (2 * MACHINE_CYCLES_PER_INTERRUPT)
+
+// Clocks that make sense for machine_set_clock: a thousand cycles or more
+// between interrupts, and few enough that the cycles per interrupt fit the
+// 32 bits a save state has for them.
+#define MACHINE_CLOCK_MIN_HZ (MACHINE_INTERRUPT_HZ * 1000)
+#define MACHINE_CLOCK_MAX_HZ 1000000000
+
+#define MACHINE_RAM_SIZE (CPU_RAM_END - CPU_RAM_START)
+#define MACHINE_VRAM 0x2400
+#define MACHINE_VRAM_SIZE 0x1c00
+
+// One Space Invaders board: ram, cpu, i/o ports and the interrupt scheduler
+// in a single block. cpu.memory always points at the block's own ram and
+// cpu.rom at a shared, read-only rom, so a machine can be restored from
+// another with machine_reset. Apart from the rom, machines share nothing and
+// any number of them can run side by side.
+typedef struct {
+        uint8_t memory[MACHINE_RAM_SIZE];
+        cpu cpu;
+        ports pts;
+        size_t cycles_per_interrupt;
+        size_t cycles_until_interrupt;
+        uint8_t interrupt;
+        size_t vblanks;  // RST 2 interrupts taken, i.e. frames completed
+        uint64_t cycles;  // cycles executed since power-on
+        uint64_t instructions;  // instructions executed since power-on
+} machine;
+
+// Machines are cache line aligned. MACHINE_STRIDE is the distance between
+// consecutive machines packed into one arena.
+#define MACHINE_ALIGN 64
+#define MACHINE_STRIDE \
+        ((sizeof(machine) + MACHINE_ALIGN - 1) & ~(size_t)(MACHINE_ALIGN - 1))
+
+machine* machine_new(rom const* r, audio_sink audio);
+void machine_delete(machine* m);
+void machine_init(machine* m, rom const* r, audio_sink audio);
+void machine_reset(machine* m, machine const* image);
+void machine_clone(machine* dst, machine const* src);
+void machine_set_clock(machine* m, size_t hz);
+size_t machine_clock(machine const* m);
+size_t machine_frame_cycles(machine const* m);
+size_t machine_step(machine* m);
+void machine_run(machine* m, size_t ncycles);
+size_t machine_run_to_vblank(machine* m, size_t ncycles);
+uint8_t const* machine_vram(machine const* m);
+
+#endif
@@ -1,22 +1,29 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "invaders.h"
-
-size_t shouldRender(clock_t lastRender) {
-        float elapsed = ((float)(clock() - lastRender)) / CLOCKS_PER_SEC;
-        return elapsed > (1.0f / 60.0f);
-}
+#include "machine.h"
 
 size_t shouldUpdate(clock_t lastUpdate) {
         float elapsed = ((float)(clock() - lastUpdate)) / CLOCKS_PER_SEC;
         return elapsed > (1.0f / 120.0f);
 }
 
+static void usage(char const* argv0) {
+        fprintf(stderr,
+                "usage: %s ROM [--boot-cache DIR] [--run-ahead FRAMES] "
+                "[--speed X|uncapped] [--fast-audio pitch|mute] "
+                "[--frameskip N|auto] [--clock HZ] [--evdev CONFIG] "
+                "[--latency FILE] [--telemetry FILE] [--record-input FILE]\n",
+                argv0);
+}
+
 int main(int argc, char* argv[static argc + 1]) {
         if (argc < 2) {
                 fprintf(stderr, "Please provide ROM file\n");
+                usage(argv[0]);
                 return EXIT_FAILURE;
         }
 
@@ -37,20 +44,109 @@ int main(int argc, char* argv[static argc + 1]) {
                 return EXIT_FAILURE;
         }
 
-        clock_t lastRender = clock();
+        float speed = 1.0f;
+        int mute_fast = 0;
+        for (int i = 2; i < argc; i += 2) {
+                if (i + 1 == argc) {
+                        fprintf(stderr, "Missing value for %s\n", argv[i]);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                }
+                if (!strcmp(argv[i], "--boot-cache")) {
+                        err = invaders_fast_boot(argv[i + 1]);
+                } else if (!strcmp(argv[i], "--run-ahead")) {
+                        char* end = 0;
+                        long frames = strtol(argv[i + 1], &end, 0);
+                        if (*end || end == argv[i + 1] || frames < 0 ||
+                            frames > INVADERS_RUN_AHEAD_MAX) {
+                                fprintf(stderr,
+                                        "Invalid run-ahead: %s (0 to %d "
+                                        "frames)\n",
+                                        argv[i + 1], INVADERS_RUN_AHEAD_MAX);
+                                err = 1;
+                        } else {
+                                err = invaders_set_run_ahead(frames);
+                        }
+                } else if (!strcmp(argv[i], "--speed")) {
+                        char* end = 0;
+                        speed = strcmp(argv[i + 1], "uncapped")
+                                    ? strtof(argv[i + 1], &end)
+                                    : 0.0f;
+                        // 0 is how invaders_set_speed spells uncapped
+                        if (end && (*end || end == argv[i + 1] ||
+                                    !(speed > 0))) {
+                                fprintf(stderr, "Invalid speed: %s\n",
+                                        argv[i + 1]);
+                                err = 1;
+                        }
+                } else if (!strcmp(argv[i], "--frameskip")) {
+                        char* end = 0;
+                        long n = strcmp(argv[i + 1], "auto")
+                                     ? strtol(argv[i + 1], &end, 0)
+                                     : INVADERS_FRAMESKIP_AUTO;
+                        if (end && (*end || end == argv[i + 1] || n < 0 ||
+                                    n > INVADERS_FRAMESKIP_MAX)) {
+                                fprintf(stderr,
+                                        "Invalid frameskip: %s (auto or 0 "
+                                        "to %d)\n",
+                                        argv[i + 1], INVADERS_FRAMESKIP_MAX);
+                                usage(argv[0]);
+                                err = 1;
+                        } else {
+                                invaders_set_frameskip(n);
+                        }
+                } else if (!strcmp(argv[i], "--evdev")) {
+                        err = invaders_use_evdev(argv[i + 1]);
+                } else if (!strcmp(argv[i], "--latency")) {
+                        err = invaders_measure_latency(argv[i + 1]);
+                } else if (!strcmp(argv[i], "--record-input")) {
+                        err = invaders_record_input(argv[i + 1]);
+                } else if (!strcmp(argv[i], "--telemetry")) {
+                        invaders_write_telemetry(argv[i + 1]);
+                } else if (!strcmp(argv[i], "--clock")) {
+                        char* end = 0;
+                        unsigned long hz = strtoul(argv[i + 1], &end, 0);
+                        if (*end || end == argv[i + 1] ||
+                            hz < MACHINE_CLOCK_MIN_HZ ||
+                            hz > MACHINE_CLOCK_MAX_HZ) {
+                                fprintf(stderr,
+                                        "Invalid clock: %s (%d to %d Hz)\n",
+                                        argv[i + 1], MACHINE_CLOCK_MIN_HZ,
+                                        MACHINE_CLOCK_MAX_HZ);
+                                err = 1;
+                        } else {
+                                invaders_set_clock(hz);
+                        }
+                } else if (!strcmp(argv[i], "--fast-audio")) {
+                        mute_fast = !strcmp(argv[i + 1], "mute");
+                        if (!mute_fast && strcmp(argv[i + 1], "pitch")) {
+                                fprintf(stderr, "Invalid fast audio: %s\n",
+                                        argv[i + 1]);
+                                usage(argv[0]);
+                                err = 1;
+                        }
+                } else {
+                        fprintf(stderr, "Unknown option: %s\n", argv[i]);
+                        err = 1;
+                }
+                if (err) {
+                        return EXIT_FAILURE;
+                }
+        }
+        invaders_set_speed(speed, mute_fast);
+
         clock_t lastUpdate = clock();
         for (;;) {
-                if (shouldUpdate(lastUpdate)) {
+                // evdev input is taken in as soon as it arrives
+                if (shouldUpdate(lastUpdate) || invaders_input_pending()) {
                         if (invaders_update()) {
                                 break;
                         }
                         lastUpdate = clock();
                 }
 
-                if (shouldRender(lastRender)) {
-                        invaders_render();
-                        lastRender = clock();
-                }
+                // draws only when a vblank has produced a frame to show
+                invaders_render();
         }
 
         return EXIT_SUCCESS;
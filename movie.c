@@ -0,0 +1,309 @@
+#include "movie.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "machine.h"
+#include "state.h"
+
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+        p[0] = v;
+        p[1] = v >> 8;
+        return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+        put16(p, v);
+        put16(p + 2, v >> 16);
+        return p + 4;
+}
+
+static uint8_t* put64(uint8_t* p, uint64_t v) {
+        put32(p, v);
+        put32(p + 4, v >> 32);
+        return p + 8;
+}
+
+static uint16_t get16(uint8_t const* p) { return p[0] | p[1] << 8; }
+
+static uint32_t get32(uint8_t const* p) {
+        return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint64_t get64(uint8_t const* p) {
+        return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+uint64_t movie_ram_hash(machine const* m) {
+        return hash_bytes(HASH_INIT, m->memory, MACHINE_RAM_SIZE);
+}
+
+movie* movie_new(rom const* r, uint32_t interval) {
+        movie* mv = calloc(1, sizeof(movie));
+        if (!mv) {
+                return 0;
+        }
+        mv->rom_hash = r ? rom_hash(r) : 0;
+        mv->interval = interval ? interval : 1;
+        return mv;
+}
+
+void movie_delete(movie* mv) {
+        if (!mv) {
+                return;
+        }
+        free(mv->runs);
+        free(mv->keyframes);
+        free(mv);
+}
+
+static int grow(void** items, size_t* cap, size_t n, size_t size) {
+        if (n < *cap) {
+                return 0;
+        }
+        size_t grown_cap = *cap ? *cap * 2 : 64;
+        void* grown = realloc(*items, grown_cap * size);
+        if (!grown) {
+                fprintf(stderr, "Failed to grow movie\n");
+                return 1;
+        }
+        *items = grown;
+        *cap = grown_cap;
+        return 0;
+}
+
+// Records the frame m is about to run: its inputs and, every interval
+// frames, the whole machine. Call once per frame after the inputs are set
+// and before running the frame.
+int movie_record(movie* mv, machine const* m) {
+        uint32_t frame = mv->frames;
+        if (frame == 0) {
+                mv->dip = m->pts.inp2.value & MOVIE_DIP_MASK;
+        }
+
+        if (frame % mv->interval == 0) {
+                if (grow((void**)&mv->keyframes, &mv->keyframes_cap,
+                         mv->nkeyframes, sizeof(movie_keyframe))) {
+                        return 1;
+                }
+                movie_keyframe* k = &mv->keyframes[mv->nkeyframes++];
+                k->frame = frame;
+                state_save(m, k->state);
+        }
+
+        movie_run* last = mv->nruns ? &mv->runs[mv->nruns - 1] : 0;
+        if (last && last->inp1 == m->pts.inp1.value &&
+            last->inp2 == m->pts.inp2.value) {
+                ++last->length;
+        } else {
+                if (grow((void**)&mv->runs, &mv->runs_cap, mv->nruns,
+                         sizeof(movie_run))) {
+                        return 1;
+                }
+                mv->runs[mv->nruns++] = (movie_run){
+                    .start = frame,
+                    .length = 1,
+                    .inp1 = m->pts.inp1.value,
+                    .inp2 = m->pts.inp2.value,
+                };
+        }
+
+        ++mv->frames;
+        return 0;
+}
+
+// Stores the hash of m's ram after the last recorded frame, which playback
+// compares against to verify the replay.
+void movie_finish(movie* mv, machine const* m) {
+        mv->final_hash = movie_ram_hash(m);
+        // an empty movie still needs a state to play from
+        if (!mv->nkeyframes &&
+            !grow((void**)&mv->keyframes, &mv->keyframes_cap, 0,
+                  sizeof(movie_keyframe))) {
+                movie_keyframe* k = &mv->keyframes[mv->nkeyframes++];
+                k->frame = 0;
+                state_save(m, k->state);
+        }
+}
+
+#define HEADER_SIZE 33
+
+int movie_save(movie const* mv, char const* path) {
+        FILE* f = fopen(path, "wb");
+        if (!f) {
+                fprintf(stderr, "Failed to open movie for writing: %s\n",
+                        path);
+                return 1;
+        }
+
+        uint8_t buf[4 + STATE_SIZE];
+        uint8_t* p = buf;
+        memcpy(p, "SIMV", 4);
+        p = put16(p + 4, MOVIE_VERSION);
+        p = put16(p, 0);
+        p = put64(p, mv->rom_hash);
+        *p++ = mv->dip;
+        p = put32(p, mv->interval);
+        p = put32(p, mv->frames);
+        p = put64(p, mv->final_hash);
+        p = put32(p, mv->nruns);
+        int err = fwrite(buf, p - buf, 1, f) != 1;
+
+        for (size_t i = 0; i < mv->nruns && !err; ++i) {
+                p = buf;
+                *p++ = mv->runs[i].inp1;
+                *p++ = mv->runs[i].inp2;
+                p = put32(p, mv->runs[i].length);
+                err = fwrite(buf, p - buf, 1, f) != 1;
+        }
+
+        put32(buf, mv->nkeyframes);
+        err = err || fwrite(buf, 4, 1, f) != 1;
+        for (size_t i = 0; i < mv->nkeyframes && !err; ++i) {
+                put32(buf, mv->keyframes[i].frame);
+                memcpy(buf + 4, mv->keyframes[i].state, STATE_SIZE);
+                err = fwrite(buf, sizeof(buf), 1, f) != 1;
+        }
+
+        if (fclose(f) || err) {
+                fprintf(stderr, "Failed to write movie: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
+
+static int read_all(FILE* f, void* buf, size_t size) {
+        return fread(buf, size, 1, f) != 1;
+}
+
+movie* movie_load(char const* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f) {
+                fprintf(stderr, "Failed to open movie: %s\n", path);
+                return 0;
+        }
+
+        movie* mv = movie_new(0, 1);
+        uint8_t buf[4 + STATE_SIZE];
+        if (!mv || read_all(f, buf, HEADER_SIZE + 4)) {
+                goto fail;
+        }
+        if (memcmp(buf, "SIMV", 4) || get16(buf + 4) != MOVIE_VERSION) {
+                fprintf(stderr, "Not a version %d movie: %s\n", MOVIE_VERSION,
+                        path);
+                goto fail;
+        }
+        mv->rom_hash = get64(buf + 8);
+        mv->dip = buf[16];
+        mv->interval = get32(buf + 17);
+        mv->frames = get32(buf + 21);
+        mv->final_hash = get64(buf + 25);
+        size_t nruns = get32(buf + HEADER_SIZE);
+        if (!mv->interval) {
+                goto fail;
+        }
+
+        uint32_t start = 0;
+        for (size_t i = 0; i < nruns; ++i) {
+                if (read_all(f, buf, 6) ||
+                    grow((void**)&mv->runs, &mv->runs_cap, mv->nruns,
+                         sizeof(movie_run))) {
+                        goto fail;
+                }
+                movie_run* run = &mv->runs[mv->nruns++];
+                *run = (movie_run){.start = start,
+                                   .length = get32(buf + 2),
+                                   .inp1 = buf[0],
+                                   .inp2 = buf[1]};
+                start += run->length;
+        }
+        if (start != mv->frames || read_all(f, buf, 4)) {
+                goto fail;
+        }
+
+        size_t nkeyframes = get32(buf);
+        for (size_t i = 0; i < nkeyframes; ++i) {
+                if (read_all(f, buf, sizeof(buf)) ||
+                    grow((void**)&mv->keyframes, &mv->keyframes_cap,
+                         mv->nkeyframes, sizeof(movie_keyframe))) {
+                        goto fail;
+                }
+                movie_keyframe* k = &mv->keyframes[mv->nkeyframes++];
+                k->frame = get32(buf);
+                memcpy(k->state, buf + 4, STATE_SIZE);
+        }
+
+        fclose(f);
+        return mv;
+
+fail:
+        fprintf(stderr, "Failed to read movie: %s\n", path);
+        fclose(f);
+        movie_delete(mv);
+        return 0;
+}
+
+// Returns non-zero unless the movie was recorded with r.
+int movie_check(movie const* mv, rom const* r) {
+        uint64_t hash = rom_hash(r);
+        if (hash != mv->rom_hash) {
+                fprintf(stderr,
+                        "Movie was recorded with rom %016llx, not %016llx\n",
+                        (unsigned long long)mv->rom_hash,
+                        (unsigned long long)hash);
+                return 1;
+        }
+        return 0;
+}
+
+// Sets pts to the inputs recorded for frame. Frames past the end of the
+// movie keep the last inputs.
+void movie_input(movie const* mv, size_t frame, ports* pts) {
+        if (!mv->nruns) {
+                return;
+        }
+        size_t lo = 0;
+        size_t hi = mv->nruns;
+        while (hi - lo > 1) {
+                size_t mid = (lo + hi) / 2;
+                if (mv->runs[mid].start <= frame) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+        pts->inp1.value = mv->runs[lo].inp1;
+        pts->inp2.value = mv->runs[lo].inp2;
+}
+
+// Brings m, which must already run the movie's rom, to the state right
+// before frame by restoring the nearest keyframe at or before it, setting
+// the DIP switches the movie was recorded with and replaying the frames in
+// between.
+int movie_seek(movie const* mv, machine* m, size_t frame) {
+        movie_keyframe const* k = 0;
+        for (size_t i = 0; i < mv->nkeyframes; ++i) {
+                if (mv->keyframes[i].frame <= frame &&
+                    (!k || mv->keyframes[i].frame > k->frame)) {
+                        k = &mv->keyframes[i];
+                }
+        }
+        if (!k || frame > mv->frames) {
+                fprintf(stderr, "Cannot seek to frame %zu\n", frame);
+                return 1;
+        }
+
+        if (state_load(m, k->state, sizeof(k->state))) {
+                return 1;
+        }
+        m->pts.inp2.value =
+            (m->pts.inp2.value & ~MOVIE_DIP_MASK) | (mv->dip & MOVIE_DIP_MASK);
+        for (size_t f = k->frame; f < frame; ++f) {
+                movie_input(mv, f, &m->pts);
+                machine_run(m, machine_frame_cycles(m));
+        }
+        return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "ports.h"
+#include "rom.h"
+#include "state.h"
+
+// Input movies: the values of both input ports for every frame, run-length
+// encoded, plus a keyframe (a complete machine state) every interval
+// frames so playback can seek without replaying from power-on. Replaying a
+// movie on the ROM it was recorded with reproduces it bit for bit; the ROM
+// hash and the RAM hash after the last frame are stored to check that.
+//
+// File layout, all integers little-endian:
+//
+//     "SIMV" u16 version u16 reserved
+//     u64 rom hash, u8 dip switches, u32 keyframe interval, u32 frames,
+//     u64 final RAM hash
+//     u32 runs, then per run: u8 inp1, u8 inp2, u32 length
+//     u32 keyframes, then per keyframe: u32 frame, a save state (state.h)
+
+#define MOVIE_VERSION 2
+#define MOVIE_DIP_MASK 0x8b  // dip3, dip5, dip6 and dip7 in inp2
+
+typedef struct {
+        uint32_t start;
+        uint32_t length;
+        uint8_t inp1;
+        uint8_t inp2;
+} movie_run;
+
+typedef struct {
+        uint32_t frame;
+        uint8_t state[STATE_SIZE];
+} movie_keyframe;
+
+typedef struct {
+        uint64_t rom_hash;
+        uint8_t dip;  // at the first frame, restored by movie_seek
+        uint32_t interval;
+        uint32_t frames;
+        uint64_t final_hash;
+
+        movie_run* runs;
+        size_t nruns;
+        size_t runs_cap;
+        movie_keyframe* keyframes;
+        size_t nkeyframes;
+        size_t keyframes_cap;
+} movie;
+
+movie* movie_new(rom const* r, uint32_t interval);
+void movie_delete(movie* mv);
+int movie_record(movie* mv, machine const* m);
+void movie_finish(movie* mv, machine const* m);
+int movie_save(movie const* mv, char const* path);
+movie* movie_load(char const* path);
+
+uint64_t movie_ram_hash(machine const* m);
+int movie_check(movie const* mv, rom const* r);
+void movie_input(movie const* mv, size_t frame, ports* pts);
+int movie_seek(movie const* mv, machine* m, size_t frame);
+
+#endif
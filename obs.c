@@ -0,0 +1,174 @@
+#include "obs.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes the upright OBS_HEIGHT x OBS_WIDTH screen to out, one byte per
+// pixel, 0 or 255. Byte 32 * x + (255 - y) / 8 of the video RAM holds pixel
+// (x, y) in bit (255 - y) % 8.
+void obs_screen(uint8_t const* vram, uint8_t* out) {
+        for (size_t x = 0; x < OBS_WIDTH; ++x) {
+                uint8_t const* column = vram + 32 * x;
+                for (size_t i = 0; i < 32; ++i) {
+                        uint8_t d = column[i];
+                        size_t y = OBS_HEIGHT - 1 - 8 * i;
+                        for (size_t b = 0; b < 8; ++b) {
+                                out[(y - b) * OBS_WIDTH + x] =
+                                    -(uint8_t)((d >> b) & 1);
+                        }
+                }
+        }
+}
+
+obs_stack* obs_stack_new(size_t width, size_t height, size_t depth,
+                         int maxpool) {
+        if (!width || width > OBS_WIDTH || !height || height > OBS_HEIGHT ||
+            !depth) {
+                fprintf(stderr, "obs: unsupported observation %zux%zux%zu\n",
+                        depth, height, width);
+                return 0;
+        }
+
+        obs_stack* s = malloc(sizeof(obs_stack));
+        if (!s) {
+                return 0;
+        }
+        *s = (obs_stack){
+            .width = width,
+            .height = height,
+            .depth = depth,
+            .maxpool = maxpool,
+            .frames = calloc(depth, width * height),
+            .acc = calloc(width * height, sizeof(uint32_t)),
+            .cols = calloc(width, sizeof(uint16_t)),
+            .rows = calloc(height, sizeof(uint16_t)),
+            .bounds = calloc(height + 1, sizeof(uint16_t)),
+        };
+        if (!s->frames || !s->acc || !s->cols || !s->rows || !s->bounds) {
+                obs_stack_delete(s);
+                return 0;
+        }
+
+        for (size_t x = 0; x < OBS_WIDTH; ++x) {
+                s->col_of[x] = x * width / OBS_WIDTH;
+                ++s->cols[s->col_of[x]];
+        }
+
+        for (size_t y = OBS_HEIGHT; y > 0; --y) {
+                size_t r = (y - 1) * height / OBS_HEIGHT;
+                s->bounds[r] = OBS_HEIGHT - (y - 1);
+                ++s->rows[r];
+        }
+
+        return s;
+}
+
+void obs_stack_delete(obs_stack* s) {
+        if (!s) {
+                return;
+        }
+        free(s->frames);
+        free(s->acc);
+        free(s->cols);
+        free(s->rows);
+        free(s->bounds);
+        free(s);
+}
+
+size_t obs_stack_size(obs_stack const* s) {
+        return s->depth * s->height * s->width;
+}
+
+static uint8_t const popcount8[256] = {
+#define B2(n) n, n + 1, n + 1, n + 2
+#define B4(n) B2(n), B2(n + 1), B2(n + 1), B2(n + 2)
+#define B6(n) B4(n), B4(n + 1), B4(n + 1), B4(n + 2)
+    B6(0), B6(1), B6(1), B6(2)
+#undef B6
+#undef B4
+#undef B2
+};
+
+// Downscales vram, or the per-pixel maximum of vram and prev_vram if that
+// is not null, into out.
+static void downsample(obs_stack* s, uint8_t const* vram,
+                       uint8_t const* prev_vram, uint8_t* out) {
+        size_t w = s->width;
+        size_t h = s->height;
+        uint32_t* acc = s->acc;
+        memset(acc, 0, w * h * sizeof(uint32_t));
+
+        for (size_t x = 0; x < OBS_WIDTH; ++x) {
+                uint8_t column[33] = {0};
+                uint8_t any = 0;
+                for (size_t i = 0; i < 32; ++i) {
+                        column[i] = vram[32 * x + i];
+                        if (prev_vram) {
+                                column[i] |= prev_vram[32 * x + i];
+                        }
+                        any |= column[i];
+                }
+                if (!any) {
+                        continue;
+                }
+
+                // lit pixels below each byte of the column
+                uint16_t below[33] = {0};
+                for (size_t i = 0; i < 32; ++i) {
+                        below[i + 1] = below[i] + popcount8[column[i]];
+                }
+
+                // lit pixels below each row boundary
+                uint32_t* a = acc + s->col_of[x];
+                size_t p = s->bounds[0];
+                uint16_t upper = below[p / 8] +
+                                 popcount8[column[p / 8] & ((1 << p % 8) - 1)];
+                for (size_t r = 0; r < h; ++r) {
+                        p = s->bounds[r + 1];
+                        uint16_t lower =
+                            below[p / 8] +
+                            popcount8[column[p / 8] & ((1 << p % 8) - 1)];
+                        a[r * w] += upper - lower;
+                        upper = lower;
+                }
+        }
+
+        for (size_t r = 0; r < h; ++r) {
+                for (size_t c = 0; c < w; ++c) {
+                        uint32_t area = (uint32_t)s->rows[r] * s->cols[c];
+                        out[r * w + c] = acc[r * w + c] * 255 / area;
+                }
+        }
+}
+
+// Adds a frame to the stack, dropping the oldest. prev_vram is the frame
+// emulated just before vram and is only read with maxpool; it may be null.
+void obs_stack_push(obs_stack* s, uint8_t const* vram,
+                    uint8_t const* prev_vram) {
+        size_t size = s->width * s->height;
+        s->head = (s->head + 1) % s->depth;
+        downsample(s, vram, s->maxpool ? prev_vram : 0,
+                   s->frames + s->head * size);
+}
+
+// Fills the whole stack with one frame, e.g. at the start of an episode.
+void obs_stack_fill(obs_stack* s, uint8_t const* vram) {
+        size_t size = s->width * s->height;
+        downsample(s, vram, 0, s->frames);
+        for (size_t i = 1; i < s->depth; ++i) {
+                memcpy(s->frames + i * size, s->frames, size);
+        }
+        s->head = 0;
+}
+
+// Writes the stack, oldest frame first, as depth x height x width bytes.
+void obs_stack_read(obs_stack const* s, uint8_t* out) {
+        size_t size = s->width * s->height;
+        for (size_t i = 1; i <= s->depth; ++i) {
+                size_t slot = (s->head + i) % s->depth;
+                memcpy(out, s->frames + slot * size, size);
+                out += size;
+        }
+}
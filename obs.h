@@ -0,0 +1,47 @@
+#ifndef OBS_H
+#define OBS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// The screen as the player sees it: the monitor is mounted rotated, so the
+// 1bpp video RAM is stored column by column, bottom to top.
+#define OBS_WIDTH 224
+#define OBS_HEIGHT 256
+
+void obs_screen(uint8_t const* vram, uint8_t* out);
+
+// Downscaled grayscale observations for agents, e.g. 84x84 with a stack of
+// the last 4. Each output pixel is the share of lit screen pixels in its
+// box, computed straight from the video RAM by counting bits, without
+// unpacking the screen first. With maxpool, a pushed frame is downscaled
+// from the per-pixel maximum of the last two emulated frames, removing the
+// flicker of objects the game only draws every other frame.
+//
+// bounds[r] is the first bit of a video RAM column (bit p is screen row
+// 255 - p) that is no longer part of output row r; output row r covers
+// bits [bounds[r + 1], bounds[r]).
+typedef struct {
+        size_t width;
+        size_t height;
+        size_t depth;
+        int maxpool;
+        size_t head;
+        uint8_t* frames;
+        uint32_t* acc;
+        size_t col_of[OBS_WIDTH];
+        uint16_t* cols;
+        uint16_t* rows;
+        uint16_t* bounds;
+} obs_stack;
+
+obs_stack* obs_stack_new(size_t width, size_t height, size_t depth,
+                         int maxpool);
+void obs_stack_delete(obs_stack* s);
+size_t obs_stack_size(obs_stack const* s);
+void obs_stack_push(obs_stack* s, uint8_t const* vram,
+                    uint8_t const* prev_vram);
+void obs_stack_fill(obs_stack* s, uint8_t const* vram);
+void obs_stack_read(obs_stack const* s, uint8_t* out);
+
+#endif
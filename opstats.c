@@ -0,0 +1,162 @@
+#include "opstats.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "disassembler.h"
+
+opstats opstats_counts;
+
+static char const* const region_names[OPSTATS_REGIONS] = {
+    "rom", "ram", "vram", "stack", "unmapped",
+};
+
+void opstats_op(uint8_t opcode, size_t cycles) {
+        opstats* s = &opstats_counts;
+        ++s->ops[opcode];
+        s->cycles[opcode] += cycles;
+        if (s->prev) {
+                ++s->pairs[s->prev - 1][opcode];
+        }
+        s->prev = opcode + 1;
+}
+
+opstats_region opstats_region_of(uint16_t addr) {
+        if (addr < CPU_RAM_START) {
+                return OPSTATS_ROM;
+        } else if (addr < 0x2400) {
+                return OPSTATS_RAM;
+        } else if (addr < CPU_RAM_END) {
+                return OPSTATS_VRAM;
+        }
+        return OPSTATS_UNMAPPED;
+}
+
+void opstats_reset() { memset(&opstats_counts, 0, sizeof(opstats)); }
+
+static int by_cycles(void const* a, void const* b) {
+        uint64_t x = opstats_counts.cycles[*(uint8_t const*)a];
+        uint64_t y = opstats_counts.cycles[*(uint8_t const*)b];
+        return (x < y) - (x > y);
+}
+
+static int by_pair_count(void const* a, void const* b) {
+        uint16_t i = *(uint16_t const*)a;
+        uint16_t k = *(uint16_t const*)b;
+        uint64_t x = opstats_counts.pairs[i >> 8][i & 0xff];
+        uint64_t y = opstats_counts.pairs[k >> 8][k & 0xff];
+        return (x < y) - (x > y);
+}
+
+static double percent(uint64_t part, uint64_t total) {
+        return total ? 100.0 * part / total : 0.0;
+}
+
+// Opcodes by cycles spent, the top most frequent opcode pairs and the
+// accesses per memory region.
+void opstats_report(FILE* f, size_t top) {
+        opstats const* s = &opstats_counts;
+        uint64_t ops = 0;
+        uint64_t cycles = 0;
+        uint8_t order[256];
+        for (int op = 0; op < 256; ++op) {
+                ops += s->ops[op];
+                cycles += s->cycles[op];
+                order[op] = op;
+        }
+        qsort(order, 256, 1, by_cycles);
+
+        fprintf(f, "%llu instructions, %llu cycles\n\n",
+                (unsigned long long)ops, (unsigned long long)cycles);
+        fprintf(f, "%-10s %12s %7s %12s %7s\n", "opcode", "count", "%",
+                "cycles", "%");
+        for (int i = 0; i < 256 && s->ops[order[i]]; ++i) {
+                uint8_t op = order[i];
+                fprintf(f, "%02x %-7s %12llu %6.2f%% %12llu %6.2f%%\n", op,
+                        opcodeName(op), (unsigned long long)s->ops[op],
+                        percent(s->ops[op], ops),
+                        (unsigned long long)s->cycles[op],
+                        percent(s->cycles[op], cycles));
+        }
+
+        uint16_t* pairs = malloc(256 * 256 * sizeof(uint16_t));
+        if (pairs) {
+                for (size_t i = 0; i < 256 * 256; ++i) {
+                        pairs[i] = i;
+                }
+                qsort(pairs, 256 * 256, sizeof(uint16_t), by_pair_count);
+                fprintf(f, "\n%-19s %12s %7s\n", "pair", "count", "%");
+                for (size_t i = 0; i < top; ++i) {
+                        uint8_t first = pairs[i] >> 8;
+                        uint8_t second = pairs[i] & 0xff;
+                        uint64_t n = s->pairs[first][second];
+                        if (!n) {
+                                break;
+                        }
+                        fprintf(f, "%-8s > %-8s %12llu %6.2f%%\n",
+                                opcodeName(first), opcodeName(second),
+                                (unsigned long long)n, percent(n, ops));
+                }
+                free(pairs);
+        }
+
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        for (int r = 0; r < OPSTATS_REGIONS; ++r) {
+                reads += s->reads[r];
+                writes += s->writes[r];
+        }
+        fprintf(f, "\n%-10s %12s %7s %12s %7s\n", "region", "reads", "%",
+                "writes", "%");
+        for (int r = 0; r < OPSTATS_REGIONS; ++r) {
+                fprintf(f, "%-10s %12llu %6.2f%% %12llu %6.2f%%\n",
+                        region_names[r], (unsigned long long)s->reads[r],
+                        percent(s->reads[r], reads),
+                        (unsigned long long)s->writes[r],
+                        percent(s->writes[r], writes));
+        }
+}
+
+// One row per non-zero counter: kind,name,count,cycles where kind is op,
+// pair, read or write and name is the opcode(s) in hex or the region.
+int opstats_write_csv(char const* path) {
+        FILE* f = fopen(path, "w");
+        if (!f) {
+                fprintf(stderr, "Failed to open opstats file: %s\n", path);
+                return 1;
+        }
+
+        opstats const* s = &opstats_counts;
+        fprintf(f, "kind,name,count,cycles\n");
+        for (int op = 0; op < 256; ++op) {
+                if (s->ops[op]) {
+                        fprintf(f, "op,\"%02x %s\",%llu,%llu\n", op,
+                                opcodeName(op), (unsigned long long)s->ops[op],
+                                (unsigned long long)s->cycles[op]);
+                }
+        }
+        for (int first = 0; first < 256; ++first) {
+                for (int second = 0; second < 256; ++second) {
+                        if (s->pairs[first][second]) {
+                                fprintf(f, "pair,%02x %02x,%llu,\n", first,
+                                        second,
+                                        (unsigned long long)
+                                            s->pairs[first][second]);
+                        }
+                }
+        }
+        for (int r = 0; r < OPSTATS_REGIONS; ++r) {
+                fprintf(f, "read,%s,%llu,\nwrite,%s,%llu,\n", region_names[r],
+                        (unsigned long long)s->reads[r], region_names[r],
+                        (unsigned long long)s->writes[r]);
+        }
+
+        if (fclose(f)) {
+                fprintf(stderr, "Failed to write opstats file: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
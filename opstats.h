@@ -0,0 +1,57 @@
+#ifndef OPSTATS_H
+#define OPSTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Instruction and memory access counts of every cpu in the process. The cpu
+// (cpu.c, and machine.c for IN and OUT) only collects them when built with
+// -DCPU_PROFILE (make opstats); without it the counting is compiled out and
+// costs nothing. The counters are plain globals, so run a single thread
+// (e.g. headless) for exact numbers.
+//
+// Stack accesses are those of pushes, pops, calls, returns and interrupts,
+// wherever sp points; every other access is counted by address. Reads
+// include the instruction fetches.
+typedef enum {
+        OPSTATS_ROM,       // 0x0000-0x1fff
+        OPSTATS_RAM,       // 0x2000-0x23ff, work ram
+        OPSTATS_VRAM,      // 0x2400-0x3fff
+        OPSTATS_STACK,
+        OPSTATS_UNMAPPED,  // 0x4000 and up
+        OPSTATS_REGIONS
+} opstats_region;
+
+typedef struct {
+        uint64_t ops[256];
+        uint64_t cycles[256];
+        uint64_t pairs[256][256];  // [first][second]
+        uint64_t reads[OPSTATS_REGIONS];
+        uint64_t writes[OPSTATS_REGIONS];
+        uint16_t prev;  // previous opcode + 1, 0 before the first
+} opstats;
+
+extern opstats opstats_counts;
+
+// The hooks the cpu calls; they expand to nothing unless CPU_PROFILE is
+// defined, arguments included.
+#ifdef CPU_PROFILE
+#define OPSTATS_OP(op, cycles) opstats_op(op, cycles)
+#define OPSTATS_READ(region) (++opstats_counts.reads[region])
+#define OPSTATS_WRITE(region) (++opstats_counts.writes[region])
+#define OPSTATS_UNREAD(region) (--opstats_counts.reads[region])
+#else
+#define OPSTATS_OP(op, cycles)
+#define OPSTATS_READ(region)
+#define OPSTATS_WRITE(region)
+#define OPSTATS_UNREAD(region)
+#endif
+
+void opstats_op(uint8_t opcode, size_t cycles);
+opstats_region opstats_region_of(uint16_t addr);
+void opstats_reset();
+void opstats_report(FILE* f, size_t top);
+int opstats_write_csv(char const* path);
+
+#endif
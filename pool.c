@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+pool* pool_new(rom const* r, size_t n) {
+        pool* p = malloc(sizeof(pool));
+        if (!p) {
+                return 0;
+        }
+        *p = (pool){.n = n, .free = calloc(n ? n : 1, sizeof(size_t))};
+
+        // slot n holds the power-on image
+        void* arena = 0;
+        if (!p->free ||
+            posix_memalign(&arena, MACHINE_ALIGN, (n + 1) * MACHINE_STRIDE)) {
+                fprintf(stderr, "Failed to allocate pool of %zu machines\n",
+                        n);
+                pool_delete(p);
+                return 0;
+        }
+        p->arena = arena;
+
+        machine* image = pool_slot(p, n);
+        machine_init(image, r, (audio_sink){0});
+
+        for (size_t i = 0; i < n; ++i) {
+                machine_reset(pool_slot(p, i), image);
+                p->free[p->nfree++] = n - 1 - i;
+        }
+
+        return p;
+}
+
+void pool_delete(pool* p) {
+        if (!p) {
+                return;
+        }
+        free(p->arena);
+        free(p->free);
+        free(p);
+}
+
+machine* pool_slot(pool* p, size_t i) {
+        return (machine*)(p->arena + i * MACHINE_STRIDE);
+}
+
+machine const* pool_image(pool const* p) {
+        return (machine const*)(p->arena + p->n * MACHINE_STRIDE);
+}
+
+// Returns a machine in its power-on state, or null when all are in use.
+machine* pool_acquire(pool* p) {
+        if (!p->nfree) {
+                return 0;
+        }
+        machine* m = pool_slot(p, p->free[--p->nfree]);
+        machine_reset(m, pool_image(p));
+        return m;
+}
+
+void pool_release(pool* p, machine* m) {
+        size_t i = ((uint8_t*)m - p->arena) / MACHINE_STRIDE;
+        p->free[p->nfree++] = i;
+}
+
+void pool_reset(pool* p, machine* m) { machine_reset(m, pool_image(p)); }
@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+// A fixed number of machines packed into one aligned arena, plus a power-on
+// image of the ROM they all share. Acquiring a machine or resetting it is a
+// single copy of the image; nothing is allocated after pool_new.
+typedef struct {
+        size_t n;
+        uint8_t* arena;
+        size_t* free;
+        size_t nfree;
+} pool;
+
+pool* pool_new(rom const* r, size_t n);
+void pool_delete(pool* p);
+machine* pool_slot(pool* p, size_t i);
+machine const* pool_image(pool const* p);
+machine* pool_acquire(pool* p);
+void pool_release(pool* p, machine* m);
+void pool_reset(pool* p, machine* m);
+
+#endif
@@ -6,15 +6,24 @@
 
 #include "audio.h"
 
-ports* ports_new() {
-        ports* pts = malloc(sizeof(ports));
-        if (pts) {
-                *pts = (ports){0};
+static void sound_play(ports* pts, audio_sound sound) {
+        if (pts->audio.play) {
+                pts->audio.play(pts->audio.ctx, sound);
         }
-        return pts;
 }
 
-void ports_delete(ports* pts) { free(pts); }
+static int sound_loop(ports* pts, audio_sound sound) {
+        if (pts->audio.loop) {
+                return pts->audio.loop(pts->audio.ctx, sound);
+        }
+        return -1;
+}
+
+static void sound_stop(ports* pts, int channel) {
+        if (pts->audio.stop) {
+                pts->audio.stop(pts->audio.ctx, channel);
+        }
+}
 
 uint8_t ports_in(ports* pts, uint8_t port) {
         uint8_t a = 0;
@@ -53,26 +62,25 @@ void ports_out(ports* pts, uint8_t port, uint8_t value) {
                 }
                 case 3:  // sounds
                 {
-                        static uint8_t prev_port_3 = 0;
-                        static int ufo_channel = 0;
+                        uint8_t prev_port_3 = pts->prev_port_3;
 
                         if ((value & 0x1) && !(prev_port_3 & 0x1)) {
-                                ufo_channel = audio_loop(SOUND_UFO);
+                                pts->ufo_channel = sound_loop(pts, SOUND_UFO);
                         } else if (!(value & 0x1) && (prev_port_3 & 0x1)) {
-                                audio_stop(ufo_channel);
+                                sound_stop(pts, pts->ufo_channel);
                         }
 
                         if ((value & 0x2) && !(prev_port_3 & 0x2)) {
-                                audio_play(SOUND_SHOT);
+                                sound_play(pts, SOUND_SHOT);
                         }
                         if ((value & 0x4) && !(prev_port_3 & 0x4)) {
-                                audio_play(SOUND_PLAYER_DIE);
+                                sound_play(pts, SOUND_PLAYER_DIE);
                         }
                         if ((value & 0x8) && !(prev_port_3 & 0x8)) {
-                                audio_play(SOUND_INVADER_DIE);
+                                sound_play(pts, SOUND_INVADER_DIE);
                         }
 
-                        prev_port_3 = value;
+                        pts->prev_port_3 = value;
                         break;
                 }
                 case 4:  // shift
@@ -82,25 +90,25 @@ void ports_out(ports* pts, uint8_t port, uint8_t value) {
                 }
                 case 5:  // more sounds
                 {
-                        static uint8_t prev_port_5 = 0;
+                        uint8_t prev_port_5 = pts->prev_port_5;
 
                         if ((value & 0x1) && !(prev_port_5 & 0x1)) {
-                                audio_play(SOUND_FLEET_MOVEMENT_1);
+                                sound_play(pts, SOUND_FLEET_MOVEMENT_1);
                         }
                         if ((value & 0x2) && !(prev_port_5 & 0x2)) {
-                                audio_play(SOUND_FLEET_MOVEMENT_2);
+                                sound_play(pts, SOUND_FLEET_MOVEMENT_2);
                         }
                         if ((value & 0x4) && !(prev_port_5 & 0x4)) {
-                                audio_play(SOUND_FLEET_MOVEMENT_3);
+                                sound_play(pts, SOUND_FLEET_MOVEMENT_3);
                         }
                         if ((value & 0x8) && !(prev_port_5 & 0x8)) {
-                                audio_play(SOUND_FLEET_MOVEMENT_4);
+                                sound_play(pts, SOUND_FLEET_MOVEMENT_4);
                         }
                         if ((value & 0x10) && !(prev_port_5 & 0x10)) {
-                                audio_play(SOUND_UFO_DIE);
+                                sound_play(pts, SOUND_UFO_DIE);
                         }
 
-                        prev_port_5 = value;
+                        pts->prev_port_5 = value;
                         break;
                 }
                 case 6:  // coin info displayed in demo screen
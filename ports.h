@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "audio.h"
+
 typedef struct {
         uint8_t credit : 1;
         uint8_t p2_start : 1;
@@ -40,11 +42,12 @@ typedef struct {
         ports_inp2 inp2;
         uint16_t shift;
         uint8_t shift_offset;
+        uint8_t prev_port_3;
+        uint8_t prev_port_5;
+        int ufo_channel;
+        audio_sink audio;
 } ports;
 
-ports* ports_new();
-void ports_delete(ports* m);
-
 uint8_t ports_in(ports* pts, uint8_t port);
 void ports_out(ports* pts, uint8_t port, uint8_t value);
 
@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frontend.h"
+#include "machine.h"
+#include "rom.h"
+#include "sampler.h"
+#include "script.h"
+
+// Profiles where the emulated program spends its cycles (see sampler.h):
+//
+//     profile ROM FRAMES SCRIPT|- FOLDED [INTERVAL] [SYMBOLS]
+//
+// samples the pc every INTERVAL cycles (997 by default, prime so that it
+// does not beat with the game's loops), prints the routines by samples and
+// the annotated disassembly of the hottest ones, and writes the stacks to
+// FOLDED for flamegraph.pl. SYMBOLS has one "<hex address> <name>" line per
+// routine.
+
+#define PROFILE_INTERVAL 997
+#define PROFILE_ANNOTATED 10
+
+int main(int argc, char* argv[static argc + 1]) {
+        if (argc < 5) {
+                fprintf(stderr,
+                        "usage: %s ROM FRAMES SCRIPT|- FOLDED [INTERVAL] "
+                        "[SYMBOLS]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        rom* r = rom_open(argv[1]);
+        if (!r) {
+                return EXIT_FAILURE;
+        }
+        size_t frames = strtoul(argv[2], 0, 0);
+        size_t interval = argc > 5 ? strtoul(argv[5], 0, 0) : 0;
+
+        script* s = 0;
+        if (strcmp(argv[3], "-")) {
+                s = script_load(argv[3]);
+                if (!s) {
+                        rom_close(r);
+                        return EXIT_FAILURE;
+                }
+        }
+        input_source input = s ? script_source(s) : (input_source){0};
+
+        machine* m = machine_new(r, (audio_sink){0});
+        sampler* sm = sampler_new(interval ? interval : PROFILE_INTERVAL);
+        int err = !m || !sm;
+        if (!err && argc > 6) {
+                err = sampler_load_symbols(sm, argv[6]);
+        }
+        for (size_t frame = 0; frame < frames && !err; ++frame) {
+                if (input.poll && input.poll(input.ctx, &m->pts)) {
+                        break;
+                }
+                sampler_run(sm, m, machine_frame_cycles(m));
+        }
+
+        if (!err) {
+                sampler_report(sm, r, stdout, PROFILE_ANNOTATED);
+                err = sampler_write_folded(sm, argv[4]);
+        }
+
+        sampler_delete(sm);
+        machine_delete(m);
+        script_delete(s);
+        rom_close(r);
+        return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
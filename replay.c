@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frontend.h"
+#include "inputlog.h"
+#include "machine.h"
+#include "movie.h"
+#include "rom.h"
+#include "script.h"
+
+// Records input movies from scripts and plays them back as fast as the
+// machine runs, checking that the replay ends in the recorded state. Input
+// logs of live sessions (inputlog.h) play back the same way.
+//
+//     replay record ROM FRAMES SCRIPT|- MOVIE [INTERVAL]
+//     replay play ROM MOVIE [FROM]
+//     replay log ROM LOG
+
+static int record(rom const* r, int argc, char* argv[]) {
+        if (argc < 6) {
+                fprintf(stderr,
+                        "usage: %s record ROM FRAMES SCRIPT|- MOVIE "
+                        "[INTERVAL]\n",
+                        argv[0]);
+                return 1;
+        }
+        size_t frames = strtoul(argv[3], 0, 0);
+        uint32_t interval = argc > 6 ? strtoul(argv[6], 0, 0) : 600;
+
+        script* s = 0;
+        if (strcmp(argv[4], "-")) {
+                s = script_load(argv[4]);
+                if (!s) {
+                        return 1;
+                }
+        }
+        input_source input = s ? script_source(s) : (input_source){0};
+
+        machine* m = machine_new(r, (audio_sink){0});
+        movie* mv = movie_new(r, interval);
+        int err = !m || !mv;
+        for (size_t frame = 0; frame < frames && !err; ++frame) {
+                if (input.poll && input.poll(input.ctx, &m->pts)) {
+                        break;
+                }
+                err = movie_record(mv, m);
+                machine_run(m, machine_frame_cycles(m));
+        }
+
+        if (!err) {
+                movie_finish(mv, m);
+                err = movie_save(mv, argv[5]);
+        }
+        if (!err) {
+                printf("%u frames, %zu runs, %zu keyframes, ram hash "
+                       "%016llx\n",
+                       (unsigned)mv->frames, mv->nruns, mv->nkeyframes,
+                       (unsigned long long)mv->final_hash);
+        }
+
+        movie_delete(mv);
+        machine_delete(m);
+        script_delete(s);
+        return err;
+}
+
+static int play(rom const* r, int argc, char* argv[]) {
+        if (argc < 4) {
+                fprintf(stderr, "usage: %s play ROM MOVIE [FROM]\n", argv[0]);
+                return 1;
+        }
+        size_t from = argc > 4 ? strtoul(argv[4], 0, 0) : 0;
+
+        movie* mv = movie_load(argv[3]);
+        if (!mv || movie_check(mv, r)) {
+                movie_delete(mv);
+                return 1;
+        }
+
+        machine* m = machine_new(r, (audio_sink){0});
+        if (!m || movie_seek(mv, m, from)) {
+                machine_delete(m);
+                movie_delete(mv);
+                return 1;
+        }
+
+        clock_t start = clock();
+        for (size_t frame = from; frame < mv->frames; ++frame) {
+                movie_input(mv, frame, &m->pts);
+                machine_run(m, machine_frame_cycles(m));
+        }
+        double elapsed = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+
+        uint64_t hash = movie_ram_hash(m);
+        size_t frames = mv->frames - from;
+        printf("%zu frames from %zu in %.3fs (%.0f frames/s), ram hash "
+               "%016llx %s\n",
+               frames, from, elapsed, elapsed > 0 ? frames / elapsed : 0.0,
+               (unsigned long long)hash,
+               hash == mv->final_hash ? "ok" : "MISMATCH");
+        int err = hash != mv->final_hash;
+
+        machine_delete(m);
+        movie_delete(mv);
+        return err;
+}
+
+static int play_log(rom const* r, int argc, char* argv[]) {
+        if (argc < 4) {
+                fprintf(stderr, "usage: %s log ROM LOG\n", argv[0]);
+                return 1;
+        }
+        machine* m = machine_new(r, (audio_sink){0});
+        if (!m) {
+                return 1;
+        }
+
+        inputlog_summary s;
+        clock_t start = clock();
+        int err = inputlog_play(argv[3], r, m, &s);
+        double elapsed = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+        if (!err) {
+                uint64_t hash = inputlog_hash(m);
+                printf("%zu events, %zu states, %llu cycles in %.3fs, state "
+                       "hash %016llx %s\n",
+                       s.events, s.states, (unsigned long long)s.cycles,
+                       elapsed, (unsigned long long)hash,
+                       hash == s.hash ? "ok" : "MISMATCH");
+                err = hash != s.hash;
+        }
+
+        machine_delete(m);
+        return err;
+}
+
+int main(int argc, char* argv[static argc + 1]) {
+        if (argc < 3 || (strcmp(argv[1], "record") && strcmp(argv[1], "play") &&
+                         strcmp(argv[1], "log"))) {
+                fprintf(stderr,
+                        "usage: %s record ROM FRAMES SCRIPT|- MOVIE "
+                        "[INTERVAL]\n"
+                        "       %s play ROM MOVIE [FROM]\n"
+                        "       %s log ROM LOG\n",
+                        argv[0], argv[0], argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        rom* r = rom_open(argv[2]);
+        if (!r) {
+                return EXIT_FAILURE;
+        }
+        int err = 0;
+        if (!strcmp(argv[1], "record")) {
+                err = record(r, argc, argv);
+        } else if (!strcmp(argv[1], "play")) {
+                err = play(r, argc, argv);
+        } else {
+                err = play_log(r, argc, argv);
+        }
+        rom_close(r);
+        return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#define _DEFAULT_SOURCE
+
+#include "rom.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+static rom* rom_wrap(void* data, size_t size) {
+        rom* r = malloc(sizeof(rom));
+        if (!r) {
+                munmap(data, ROM_SIZE);
+                return 0;
+        }
+        *r = (rom){.data = data, .size = size};
+        return r;
+}
+
+// Reads fsize bytes from f into a fresh shared mapping and seals it
+// read-only.
+rom* rom_read(FILE* f, size_t fsize) {
+        if (fsize > ROM_SIZE) {
+                fprintf(stderr,
+                        "Provided file too big, wrong file or corrupted?\n");
+                return 0;
+        }
+
+        void* data = mmap(0, ROM_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+                fprintf(stderr, "Failed to map ROM\n");
+                return 0;
+        }
+        if (fread(data, fsize, 1, f) != 1 ||
+            mprotect(data, ROM_SIZE, PROT_READ)) {
+                fprintf(stderr, "Failed to read ROM\n");
+                munmap(data, ROM_SIZE);
+                return 0;
+        }
+
+        return rom_wrap(data, fsize);
+}
+
+// Maps the file directly when it covers the whole ROM, so the page cache
+// backs every instance in every process.
+rom* rom_open(char const* path) {
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st)) {
+                fprintf(stderr, "Failed to open file in binary mode: %s\n",
+                        path);
+                if (fd >= 0) {
+                        close(fd);
+                }
+                return 0;
+        }
+
+        if (st.st_size <= 0) {
+                fprintf(stderr, "Provided file is empty: %s\n", path);
+                close(fd);
+                return 0;
+        }
+        if (st.st_size > ROM_SIZE) {
+                fprintf(stderr,
+                        "Provided file too big, wrong file or corrupted?\n");
+                close(fd);
+                return 0;
+        }
+
+        if (st.st_size == ROM_SIZE) {
+                void* data =
+                    mmap(0, ROM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if (data == MAP_FAILED) {
+                        fprintf(stderr, "Failed to map ROM: %s\n", path);
+                        return 0;
+                }
+                return rom_wrap(data, ROM_SIZE);
+        }
+
+        FILE* f = fdopen(fd, "rb");
+        if (!f) {
+                close(fd);
+                return 0;
+        }
+        rom* r = rom_read(f, st.st_size);
+        fclose(f);
+        return r;
+}
+
+void rom_close(rom* r) {
+        if (!r) {
+                return;
+        }
+        munmap((void*)r->data, ROM_SIZE);
+        free(r);
+}
+
+// Identifies a ROM image by its contents, for files that must only be used
+// with the ROM they were made with.
+uint64_t rom_hash(rom const* r) {
+        return hash_bytes(HASH_INIT, r->data, r->size);
+}
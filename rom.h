@@ -0,0 +1,23 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROM_SIZE 0x2000
+
+// A read-only ROM image shared by every machine that runs it. data always
+// has ROM_SIZE readable bytes (files shorter than that are zero padded) and
+// is a shared mapping, so forked workers keep using the same pages.
+typedef struct {
+        uint8_t const* data;
+        size_t size;
+} rom;
+
+rom* rom_open(char const* path);
+rom* rom_read(FILE* f, size_t fsize);
+void rom_close(rom* r);
+uint64_t rom_hash(rom const* r);
+
+#endif
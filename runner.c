@@ -0,0 +1,53 @@
+#include "runner.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "pool.h"
+#include "rom.h"
+
+runner* runner_new(rom const* r, size_t n) {
+        runner* g = malloc(sizeof(runner));
+        if (!g) {
+                return 0;
+        }
+        *g = (runner){.n = n, .pool = pool_new(r, n)};
+        if (!g->pool) {
+                runner_delete(g);
+                return 0;
+        }
+
+        // acquire every slot so they are all in use and in order
+        for (size_t i = 0; i < n; ++i) {
+                pool_acquire(g->pool);
+        }
+
+        return g;
+}
+
+void runner_delete(runner* g) {
+        if (!g) {
+                return;
+        }
+        pool_delete(g->pool);
+        free(g);
+}
+
+machine* runner_machine(runner* g, size_t i) { return pool_slot(g->pool, i); }
+
+// Sets every machine's input ports and runs each of them for one frame in
+// turn. Either input array may be null to leave that port unchanged.
+void runner_frame(runner* g, uint8_t const* inp1, uint8_t const* inp2) {
+        for (size_t i = 0; i < g->n; ++i) {
+                machine* m = pool_slot(g->pool, i);
+                if (inp1) {
+                        m->pts.inp1.value = inp1[i];
+                }
+                if (inp2) {
+                        m->pts.inp2.value = inp2[i];
+                }
+                machine_run(m, machine_frame_cycles(m));
+        }
+}
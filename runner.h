@@ -0,0 +1,25 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "pool.h"
+#include "rom.h"
+
+// A number of machines running the same ROM a frame at a time, each
+// machine's frame run to the end before the next one starts. The machines
+// live in one pool, so a frame walks a single arena linearly, one
+// MACHINE_STRIDE per machine.
+typedef struct {
+        size_t n;
+        pool* pool;
+} runner;
+
+runner* runner_new(rom const* r, size_t n);
+void runner_delete(runner* g);
+machine* runner_machine(runner* g, size_t i);
+void runner_frame(runner* g, uint8_t const* inp1, uint8_t const* inp2);
+
+#endif
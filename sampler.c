@@ -0,0 +1,407 @@
+#include "sampler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disassembler.h"
+#include "hash.h"
+#include "machine.h"
+#include "rom.h"
+
+// unsampled instructions in a row shown before the listing skips ahead
+#define SAMPLER_CONTEXT 3
+
+sampler* sampler_new(size_t interval) {
+        sampler* s = calloc(1, sizeof(sampler));
+        if (!s) {
+                fprintf(stderr, "Failed to allocate sampler\n");
+                return 0;
+        }
+        s->interval = interval ? interval : 1;
+        s->countdown = s->interval;
+        s->cap = 1024;
+        s->stacks = calloc(s->cap, sizeof(sampler_stack));
+        if (!s->stacks) {
+                fprintf(stderr, "Failed to allocate sampler\n");
+                free(s);
+                return 0;
+        }
+        for (size_t i = 0; i <= ROM_SIZE; ++i) {
+                s->first[i] = UINT16_MAX;
+        }
+        return s;
+}
+
+void sampler_delete(sampler* s) {
+        if (!s) {
+                return;
+        }
+        free(s->stacks);
+        free(s->symbols);
+        free(s);
+}
+
+static int by_addr(void const* a, void const* b) {
+        return ((sampler_symbol const*)a)->addr -
+               ((sampler_symbol const*)b)->addr;
+}
+
+// Reads one "<hex address> <name>" per line; # starts a comment.
+int sampler_load_symbols(sampler* s, char const* path) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+                fprintf(stderr, "Failed to open symbol file: %s\n", path);
+                return 1;
+        }
+
+        size_t cap = s->nsymbols;
+        size_t lineno = 0;
+        char line[256] = "";
+        while (fgets(line, sizeof(line), f)) {
+                ++lineno;
+                unsigned addr = 0;
+                char name[SAMPLER_NAME_LEN] = "";
+                int n = sscanf(line, "%x %47s", &addr, name);
+                if (n <= 0 || line[strspn(line, " \t")] == '#') {
+                        continue;
+                }
+                if (n < 2 || addr >= ROM_SIZE) {
+                        fprintf(stderr, "%s:%zu: expected <address> <name>\n",
+                                path, lineno);
+                        fclose(f);
+                        return 1;
+                }
+                if (s->nsymbols == cap) {
+                        cap = cap ? cap * 2 : 256;
+                        sampler_symbol* grown =
+                            realloc(s->symbols, cap * sizeof(sampler_symbol));
+                        if (!grown) {
+                                fclose(f);
+                                return 1;
+                        }
+                        s->symbols = grown;
+                }
+                sampler_symbol* sym = &s->symbols[s->nsymbols++];
+                sym->addr = addr;
+                strcpy(sym->name, name);
+        }
+        fclose(f);
+
+        qsort(s->symbols, s->nsymbols, sizeof(sampler_symbol), by_addr);
+        return 0;
+}
+
+// Nearest symbol at or below addr, if any.
+static sampler_symbol const* symbol(sampler const* s, uint16_t addr) {
+        size_t lo = 0;
+        size_t hi = s->nsymbols;
+        while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (s->symbols[mid].addr <= addr) {
+                        lo = mid + 1;
+                } else {
+                        hi = mid;
+                }
+        }
+        return lo ? &s->symbols[lo - 1] : 0;
+}
+
+static void routine_name(sampler const* s, uint16_t start, char* name) {
+        sampler_symbol const* sym = start < ROM_SIZE ? symbol(s, start) : 0;
+        if (sym && sym->addr == start) {
+                strcpy(name, sym->name);
+        } else if (sym) {
+                sprintf(name, "%s+0x%x", sym->name, start - sym->addr);
+        } else if (start < ROM_SIZE) {
+                sprintf(name, "sub_%04x", start);
+        } else {
+                strcpy(name, "top");
+        }
+}
+
+// CALL, the conditional calls and RST.
+static int is_call(uint8_t op) {
+        return op == 0xcd || (op & 0xc7) == 0xc4 || (op & 0xc7) == 0xc7;
+}
+
+// RET and the conditional returns.
+static int is_ret(uint8_t op) { return op == 0xc9 || (op & 0xc7) == 0xc0; }
+
+// Drops the frames whose return address is below sp, which the program has
+// popped or abandoned.
+static void unwind(sampler* s, uint32_t sp) {
+        while (s->ncalls && s->calls[s->ncalls - 1].slot < sp) {
+                --s->ncalls;
+        }
+}
+
+// Pushes a frame for start, whose return address has just been stored at
+// slot. A full shadow stack leaves the call out; its return then pops
+// nothing, as no frame has that slot.
+static void enter(sampler* s, cpu const* c, uint16_t start, uint16_t slot) {
+        unwind(s, slot + 1u);
+        if (s->ncalls == SAMPLER_SHADOW) {
+                return;
+        }
+        s->calls[s->ncalls++] = (sampler_frame){
+            .start = start,
+            .ret = cpu_read(c, slot + 1) << 8 | cpu_read(c, slot),
+            .slot = slot,
+        };
+}
+
+// Follows one machine step, which ran op from pc and sp and was interrupted
+// afterwards if interrupted is set. The interrupt pushes the pc the
+// instruction left, so the instruction's own pc and sp are found under it.
+static void track(sampler* s, machine const* m, uint8_t op, uint16_t sp,
+                  int interrupted) {
+        cpu const* c = &m->cpu;
+        uint16_t after_sp = c->sp;
+        uint16_t after_pc = c->pc;
+        if (interrupted) {
+                after_sp += 2;
+                after_pc = cpu_read(c, c->sp + 1) << 8 | cpu_read(c, c->sp);
+        }
+        if (is_call(op) && after_sp == (uint16_t)(sp - 2)) {
+                enter(s, c, after_pc, after_sp);
+        } else if (is_ret(op) && after_sp == (uint16_t)(sp + 2)) {
+                unwind(s, sp + 1u);
+        }
+        if (interrupted) {
+                enter(s, c, c->pc, c->sp);
+        }
+}
+
+static void add_stack(sampler* s, sampler_stack const* st) {
+        if (2 * (s->nstacks + 1) > s->cap) {
+                sampler_stack* old = s->stacks;
+                size_t old_cap = s->cap;
+                sampler_stack* grown = calloc(2 * old_cap, sizeof(*grown));
+                if (!grown) {
+                        return;
+                }
+                s->stacks = grown;
+                s->cap = 2 * old_cap;
+                s->nstacks = 0;
+                for (size_t i = 0; i < old_cap; ++i) {
+                        if (old[i].count) {
+                                add_stack(s, &old[i]);
+                        }
+                }
+                free(old);
+        }
+
+        size_t size = st->depth * sizeof(uint16_t);
+        size_t i = hash_bytes(HASH_INIT, st->frames, size) & (s->cap - 1);
+        for (;; i = (i + 1) & (s->cap - 1)) {
+                sampler_stack* e = &s->stacks[i];
+                if (!e->count) {
+                        *e = *st;
+                        ++s->nstacks;
+                        return;
+                }
+                if (e->depth == st->depth &&
+                    !memcmp(e->frames, st->frames, size)) {
+                        e->count += st->count;
+                        return;
+                }
+        }
+}
+
+static void sample(sampler* s, machine const* m) {
+        cpu const* c = &m->cpu;
+        ++s->samples;
+        if (c->pc >= ROM_SIZE) {
+                ++s->outside;
+                return;
+        }
+        ++s->hits[c->pc];
+
+        // the code below the outermost frame kept has no known start and is
+        // named after where it made that call
+        unwind(s, c->sp);
+        sampler_stack st = {.count = 1};
+        uint16_t outer = c->pc;
+        for (size_t i = s->ncalls; i-- > 0 && st.depth < SAMPLER_DEPTH - 1;) {
+                sampler_frame const* f = &s->calls[i];
+                st.frames[st.depth++] =
+                    f->start < ROM_SIZE ? f->start : SAMPLER_TOP;
+                outer = f->ret;
+        }
+        sampler_symbol const* sym = symbol(s, outer);
+        st.frames[st.depth++] = sym ? sym->addr : SAMPLER_TOP;
+
+        uint16_t self = st.frames[0];
+        ++s->self[self];
+        if (c->pc < s->first[self]) {
+                s->first[self] = c->pc;
+        }
+        if (c->pc > s->last[self]) {
+                s->last[self] = c->pc;
+        }
+        add_stack(s, &st);
+}
+
+// Runs m for n cycles like machine_run, sampling every interval cycles.
+void sampler_run(sampler* s, machine* m, size_t n) {
+        while (n) {
+                uint8_t op = cpu_read(&m->cpu, m->cpu.pc);
+                uint16_t sp = m->cpu.sp;
+                uint8_t interrupt = m->interrupt;
+                size_t cycles = machine_step(m);
+                track(s, m, op, sp, m->interrupt != interrupt);
+                while (cycles >= s->countdown) {
+                        sample(s, m);
+                        s->countdown += s->interval;
+                }
+                s->countdown -= cycles;
+                if (cycles > n) {
+                        break;
+                }
+                n -= cycles;
+        }
+}
+
+static double percent(uint64_t part, uint64_t total) {
+        return total ? 100.0 * part / total : 0.0;
+}
+
+static sampler const* sorting;
+
+static int by_self(void const* a, void const* b) {
+        uint64_t x = sorting->self[*(uint16_t const*)a];
+        uint64_t y = sorting->self[*(uint16_t const*)b];
+        return (x < y) - (x > y);
+}
+
+// Disassembles a routine from its start to its last sampled instruction,
+// with the samples of every instruction. Runs of unsampled instructions are
+// cut down to some context around the sampled ones.
+static void annotate(sampler const* s, rom const* r, FILE* f,
+                     uint16_t start) {
+        uint16_t from = start < s->first[start] ? start : s->first[start];
+        if (start == SAMPLER_TOP) {
+                from = s->first[start];
+        }
+        uint16_t to = s->last[start];
+
+        size_t quiet = 0;
+        for (uint32_t pc = from; pc <= to;) {
+                uint8_t code[3] = {0};
+                for (int i = 0; i < 3 && pc + i < ROM_SIZE; ++i) {
+                        code[i] = r->data[pc + i];
+                }
+                char text[32] = "";
+                int operands = disassembleOp(0, code, text);
+                if (operands < 0) {
+                        operands = 0;
+                        sprintf(text, "%02x ?", code[0]);
+                }
+
+                // upcoming samples within the context decide if this line
+                // is shown
+                uint64_t near = 0;
+                for (uint32_t a = pc; a < pc + 3 * (SAMPLER_CONTEXT + 1) &&
+                                      a < ROM_SIZE;
+                     ++a) {
+                        near |= s->hits[a];
+                }
+                if (s->hits[pc]) {
+                        quiet = 0;
+                } else {
+                        ++quiet;
+                }
+                if (pc == from || quiet <= SAMPLER_CONTEXT || near) {
+                        if (s->hits[pc]) {
+                                fprintf(f, "  %6.2f%% %8llu  %04x  %s\n",
+                                        percent(s->hits[pc], s->samples),
+                                        (unsigned long long)s->hits[pc], pc,
+                                        text);
+                        } else {
+                                fprintf(f, "  %7s %8s  %04x  %s\n", "", "",
+                                        pc, text);
+                        }
+                } else if (quiet == SAMPLER_CONTEXT + 1) {
+                        fprintf(f, "  %7s %8s  ...\n", "", "");
+                }
+                pc += 1 + operands;
+        }
+}
+
+// Routines by samples taken in their own code, then the annotated
+// disassembly of the top of them.
+void sampler_report(sampler const* s, rom const* r, FILE* f, size_t top) {
+        uint16_t* order = malloc((ROM_SIZE + 1) * sizeof(uint16_t));
+        if (!order) {
+                return;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i <= ROM_SIZE; ++i) {
+                if (s->self[i]) {
+                        order[n++] = i;
+                }
+        }
+        sorting = s;
+        qsort(order, n, sizeof(uint16_t), by_self);
+
+        fprintf(f, "%llu samples every %zu cycles, %llu outside rom\n\n",
+                (unsigned long long)s->samples, s->interval,
+                (unsigned long long)s->outside);
+        fprintf(f, "%8s %10s  %-6s %s\n", "self", "samples", "start",
+                "routine");
+        for (size_t i = 0; i < n; ++i) {
+                char name[SAMPLER_NAME_LEN + 8];
+                routine_name(s, order[i], name);
+                char start[8] = "-";
+                if (order[i] < ROM_SIZE) {
+                        sprintf(start, "%04x", order[i]);
+                }
+                fprintf(f, "%7.2f%% %10llu  %-6s %s\n",
+                        percent(s->self[order[i]], s->samples),
+                        (unsigned long long)s->self[order[i]], start, name);
+        }
+
+        for (size_t i = 0; i < n && i < top; ++i) {
+                char name[SAMPLER_NAME_LEN + 8];
+                routine_name(s, order[i], name);
+                fprintf(f, "\n%s (%.2f%%)\n", name,
+                        percent(s->self[order[i]], s->samples));
+                annotate(s, r, f, order[i]);
+        }
+        free(order);
+}
+
+// Writes the stacks in the folded format of flamegraph.pl and compatible
+// tools: the routines outermost first, separated by semicolons, then the
+// number of samples.
+int sampler_write_folded(sampler const* s, char const* path) {
+        FILE* f = fopen(path, "w");
+        if (!f) {
+                fprintf(stderr, "Failed to open folded stacks: %s\n", path);
+                return 1;
+        }
+
+        for (size_t i = 0; i < s->cap; ++i) {
+                sampler_stack const* st = &s->stacks[i];
+                if (!st->count) {
+                        continue;
+                }
+                for (size_t d = st->depth; d-- > 0;) {
+                        char name[SAMPLER_NAME_LEN + 8];
+                        routine_name(s, st->frames[d], name);
+                        fprintf(f, "%s%c", name, d ? ';' : ' ');
+                }
+                fprintf(f, "%llu\n", (unsigned long long)st->count);
+        }
+        if (s->outside) {
+                fprintf(f, "ram %llu\n", (unsigned long long)s->outside);
+        }
+
+        if (fclose(f)) {
+                fprintf(stderr, "Failed to write folded stacks: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "rom.h"
+
+// A sampling profiler for the emulated program. Every interval cycles it
+// records the pc and the chain of routines that led there. sampler_run steps
+// the machine itself and keeps the chain on a shadow call stack: every CALL,
+// RST and interrupt that is taken pushes the routine it enters, and every
+// RET that is taken pops the frame whose return address it used. Interrupt
+// handlers therefore show up as routines of their own, nested in the code
+// they interrupted. Frames whose return address the program drops, by
+// popping it or reloading sp, go once sp passes them.
+//
+// Routines are named after the nearest symbol at or below their start, plus
+// the offset from it if any, when a symbol file is given, and sub_XXXX
+// otherwise. Code outside any call seen (the main loop, or code entered
+// before sampling began) is attributed to the nearest symbol at or below
+// the pc it calls from, or to "top".
+#define SAMPLER_DEPTH 16
+#define SAMPLER_SHADOW 256  // frames the shadow call stack holds
+#define SAMPLER_NAME_LEN 48
+#define SAMPLER_TOP ROM_SIZE  // routine of code with no known start
+
+typedef struct {
+        uint16_t frames[SAMPLER_DEPTH];  // routine starts, innermost first
+        size_t depth;
+        uint64_t count;
+} sampler_stack;
+
+typedef struct {
+        uint16_t addr;
+        char name[SAMPLER_NAME_LEN];
+} sampler_symbol;
+
+typedef struct {
+        uint16_t start;  // routine entered
+        uint16_t ret;    // address it returns to
+        uint16_t slot;   // where the return address is on the stack
+} sampler_frame;
+
+typedef struct {
+        size_t interval;
+        size_t countdown;
+        uint64_t samples;
+        uint64_t outside;  // samples with the pc outside rom
+
+        uint64_t hits[ROM_SIZE];          // samples per pc
+        uint64_t self[ROM_SIZE + 1];      // samples per routine start
+        uint16_t first[ROM_SIZE + 1];     // lowest pc sampled per routine
+        uint16_t last[ROM_SIZE + 1];      // highest pc sampled per routine
+
+        // distinct stacks in an open addressing table of cap entries
+        sampler_stack* stacks;
+        size_t nstacks;
+        size_t cap;
+
+        sampler_symbol* symbols;  // sorted by address
+        size_t nsymbols;
+
+        // shadow call stack, outermost first
+        sampler_frame calls[SAMPLER_SHADOW];
+        size_t ncalls;
+} sampler;
+
+sampler* sampler_new(size_t interval);
+void sampler_delete(sampler* s);
+int sampler_load_symbols(sampler* s, char const* path);
+void sampler_run(sampler* s, machine* m, size_t ncycles);
+void sampler_report(sampler const* s, rom const* r, FILE* f, size_t top);
+int sampler_write_folded(sampler const* s, char const* path);
+
+#endif
@@ -0,0 +1,112 @@
+#include "script.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compare_events(void const* a, void const* b) {
+        script_event const* x = a;
+        script_event const* y = b;
+        if (x->frame != y->frame) {
+                return (x->frame > y->frame) - (x->frame < y->frame);
+        }
+        return (x->line > y->line) - (x->line < y->line);
+}
+
+script* script_load(char const* path) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+                fprintf(stderr, "Failed to open input script: %s\n", path);
+                return 0;
+        }
+
+        script* s = malloc(sizeof(script));
+        if (!s) {
+                fclose(f);
+                return 0;
+        }
+        *s = (script){0};
+
+        size_t cap = 0;
+        size_t lineno = 0;
+        char line[256] = "";
+        while (fgets(line, sizeof(line), f)) {
+                ++lineno;
+                char* p = line;
+                while (*p == ' ' || *p == '\t') {
+                        ++p;
+                }
+                if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0) {
+                        continue;
+                }
+
+                char* end = 0;
+                unsigned long frame = strtoul(p, &end, 0);
+                int bad = end == p;
+                char* last = end;
+                unsigned long inp1 = strtoul(last, &end, 0);
+                bad |= end == last;
+                last = end;
+                unsigned long inp2 = strtoul(last, &end, 0);
+                bad |= end == last;
+                if (bad || inp1 > 0xff || inp2 > 0xff) {
+                        fprintf(stderr,
+                                "%s:%zu: expected <frame> <inp1> <inp2>\n",
+                                path, lineno);
+                        script_delete(s);
+                        fclose(f);
+                        return 0;
+                }
+
+                if (s->len == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        script_event* events =
+                            realloc(s->events, cap * sizeof(script_event));
+                        if (!events) {
+                                script_delete(s);
+                                fclose(f);
+                                return 0;
+                        }
+                        s->events = events;
+                }
+                s->events[s->len++] = (script_event){
+                    .frame = frame,
+                    .line = lineno,
+                    .inp1 = inp1,
+                    .inp2 = inp2,
+                };
+        }
+        fclose(f);
+
+        qsort(s->events, s->len, sizeof(script_event), compare_events);
+        return s;
+}
+
+void script_delete(script* s) {
+        if (!s) {
+                return;
+        }
+        free(s->events);
+        free(s);
+}
+
+void script_rewind(script* s) {
+        s->next = 0;
+        s->frame = 0;
+}
+
+// Called once per emulated frame.
+static int script_poll(void* ctx, ports* pts) {
+        script* s = ctx;
+        while (s->next < s->len && s->events[s->next].frame <= s->frame) {
+                pts->inp1.value = s->events[s->next].inp1;
+                pts->inp2.value = s->events[s->next].inp2;
+                ++s->next;
+        }
+        ++s->frame;
+        return 0;
+}
+
+input_source script_source(script* s) {
+        return (input_source){.ctx = s, .poll = script_poll};
+}
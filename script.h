@@ -0,0 +1,37 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "frontend.h"
+#include "ports.h"
+
+// A scripted input source. Each line of a script file is
+//
+//     <frame> <inp1> <inp2>
+//
+// and sets both input ports from that frame on. Numbers may be decimal or
+// 0x-prefixed hex, blank lines and lines starting with '#' are ignored.
+// Lines need not be in frame order; of lines naming the same frame, the
+// last one wins.
+typedef struct {
+        size_t frame;
+        size_t line;  // orders events of the same frame
+        uint8_t inp1;
+        uint8_t inp2;
+} script_event;
+
+typedef struct {
+        script_event* events;
+        size_t len;
+        size_t next;
+        size_t frame;
+} script;
+
+script* script_load(char const* path);
+void script_delete(script* s);
+void script_rewind(script* s);
+input_source script_source(script* s);
+
+#endif
@@ -0,0 +1,128 @@
+#include "state.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+
+// the header layout is part of the format
+typedef char state_header_size[sizeof(state_header) == STATE_HEADER_SIZE ? 1
+                                                                         : -1];
+
+// Writes STATE_SIZE bytes describing m to buf.
+void state_save(machine const* m, void* buf) {
+        cpu const* c = &m->cpu;
+        state_header h = {
+            .magic = {'S', 'I', 'S', 'T'},
+            .version = STATE_VERSION,
+            .cycles_until_interrupt = m->cycles_until_interrupt,
+            .cycles_per_interrupt =
+                m->cycles_per_interrupt == MACHINE_CYCLES_PER_INTERRUPT
+                    ? 0
+                    : m->cycles_per_interrupt,
+            .sp = c->sp,
+            .pc = c->pc,
+            .a = c->a,
+            .b = c->b,
+            .c = c->c,
+            .d = c->d,
+            .e = c->e,
+            .h = c->h,
+            .l = c->l,
+            .flags = c->cc.z | c->cc.s << 1 | c->cc.p << 2 | c->cc.cy << 3 |
+                     c->cc.ac << 4,
+            .int_enable = c->int_enable,
+            .interrupt = m->interrupt,
+            .inp1 = m->pts.inp1.value,
+            .inp2 = m->pts.inp2.value,
+            .shift = m->pts.shift,
+            .shift_offset = m->pts.shift_offset,
+            .prev_port_3 = m->pts.prev_port_3,
+            .prev_port_5 = m->pts.prev_port_5,
+        };
+        memcpy(buf, &h, STATE_HEADER_SIZE);
+        memcpy((uint8_t*)buf + STATE_HEADER_SIZE, m->memory,
+               MACHINE_RAM_SIZE);
+}
+
+// Restores m from a state in buf. m keeps its rom and audio sink. Returns
+// non-zero, leaving m untouched, if buf does not hold a state of this
+// version.
+int state_load(machine* m, void const* buf, size_t size) {
+        state_header h;
+        if (size < STATE_SIZE) {
+                fprintf(stderr, "Save state is truncated\n");
+                return 1;
+        }
+        memcpy(&h, buf, STATE_HEADER_SIZE);
+        if (memcmp(h.magic, "SIST", 4) || h.version != STATE_VERSION) {
+                fprintf(stderr, "Not a version %d save state\n",
+                        STATE_VERSION);
+                return 1;
+        }
+
+        cpu* c = &m->cpu;
+        c->a = h.a;
+        c->b = h.b;
+        c->c = h.c;
+        c->d = h.d;
+        c->e = h.e;
+        c->h = h.h;
+        c->l = h.l;
+        c->sp = h.sp;
+        c->pc = h.pc;
+        c->cc.z = h.flags;
+        c->cc.s = h.flags >> 1;
+        c->cc.p = h.flags >> 2;
+        c->cc.cy = h.flags >> 3;
+        c->cc.ac = h.flags >> 4;
+        c->int_enable = h.int_enable;
+
+        m->pts.inp1.value = h.inp1;
+        m->pts.inp2.value = h.inp2;
+        m->pts.shift = h.shift;
+        m->pts.shift_offset = h.shift_offset;
+        m->pts.prev_port_3 = h.prev_port_3;
+        m->pts.prev_port_5 = h.prev_port_5;
+
+        m->cycles_per_interrupt = h.cycles_per_interrupt
+                                      ? h.cycles_per_interrupt
+                                      : MACHINE_CYCLES_PER_INTERRUPT;
+        m->cycles_until_interrupt = h.cycles_until_interrupt;
+        m->interrupt = h.interrupt;
+        memcpy(m->memory, (uint8_t const*)buf + STATE_HEADER_SIZE,
+               MACHINE_RAM_SIZE);
+        return 0;
+}
+
+int state_write(machine const* m, char const* path) {
+        uint8_t buf[STATE_SIZE];
+        state_save(m, buf);
+
+        FILE* f = fopen(path, "wb");
+        if (!f) {
+                fprintf(stderr, "Failed to open save state for writing: %s\n",
+                        path);
+                return 1;
+        }
+        int err = fwrite(buf, sizeof(buf), 1, f) != 1;
+        if (fclose(f) || err) {
+                fprintf(stderr, "Failed to write save state: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
+
+int state_read(machine* m, char const* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f) {
+                fprintf(stderr, "Failed to open save state: %s\n", path);
+                return 1;
+        }
+        uint8_t buf[STATE_SIZE];
+        size_t size = fread(buf, 1, sizeof(buf), f);
+        fclose(f);
+        return state_load(m, buf, size);
+}
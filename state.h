@@ -0,0 +1,55 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+
+// Save states: everything that makes up a running machine (registers and
+// flags, int_enable, the 8 KiB of ram, the shift register, the sound port
+// edges, the interrupt scheduler and the cpu clock) in a versioned,
+// fixed-layout block of STATE_SIZE bytes. A state is a 48 byte header
+// followed by the ram, so saving and loading are a header copy and one
+// 8 KiB memcpy each way.
+//
+// Multi-byte fields are little-endian and written in host order, which
+// holds on every target this builds for.
+#define STATE_VERSION 1
+#define STATE_HEADER_SIZE 48
+#define STATE_SIZE (STATE_HEADER_SIZE + MACHINE_RAM_SIZE)
+
+typedef struct {
+        uint8_t magic[4];  // "SIST"
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t cycles_until_interrupt;
+        uint16_t sp;
+        uint16_t pc;
+        uint8_t a;
+        uint8_t b;
+        uint8_t c;
+        uint8_t d;
+        uint8_t e;
+        uint8_t h;
+        uint8_t l;
+        uint8_t flags;  // z, s, p, cy, ac from bit 0 up
+        uint8_t int_enable;
+        uint8_t interrupt;
+        uint8_t inp1;
+        uint8_t inp2;
+        uint16_t shift;
+        uint8_t shift_offset;
+        uint8_t prev_port_3;
+        uint8_t prev_port_5;
+        uint8_t pad[3];
+        uint32_t cycles_per_interrupt;  // 0 in states saved at 2 MHz
+        uint8_t reserved2[STATE_HEADER_SIZE - 40];
+} state_header;
+
+void state_save(machine const* m, void* buf);
+int state_load(machine* m, void const* buf, size_t size);
+int state_write(machine const* m, char const* path);
+int state_read(machine* m, char const* path);
+
+#endif
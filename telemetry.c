@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "telemetry.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "machine.h"
+
+static char const* const phase_names[TELEMETRY_PHASES] = {
+    "poll", "emulate", "audio", "convert", "present", "update", "render",
+};
+
+void telemetry_init(telemetry* t) {
+        memset(t, 0, sizeof(telemetry));
+        for (int p = 0; p < TELEMETRY_PHASES; ++p) {
+                t->phases[p].min = UINT64_MAX;
+        }
+        t->start_ns = telemetry_now_ns();
+        t->window_ns = t->start_ns;
+}
+
+uint64_t telemetry_now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static size_t bucket(uint64_t ns) {
+        if (ns < 2 * TELEMETRY_SUB_BUCKETS) {
+                return ns;
+        }
+        if (ns >> TELEMETRY_MAX_BITS) {
+                return TELEMETRY_BUCKETS - 1;
+        }
+        // ns >> shift keeps the top TELEMETRY_SUB_BITS + 1 bits
+        int shift = 63 - __builtin_clzll(ns) - TELEMETRY_SUB_BITS;
+        return shift * TELEMETRY_SUB_BUCKETS + (ns >> shift);
+}
+
+// Smallest value that falls into the bucket after b.
+static uint64_t bucket_limit(size_t b) {
+        if (b < 2 * TELEMETRY_SUB_BUCKETS) {
+                return b + 1;
+        }
+        size_t shift = b / TELEMETRY_SUB_BUCKETS - 1;
+        uint64_t top = b % TELEMETRY_SUB_BUCKETS + TELEMETRY_SUB_BUCKETS;
+        return (top + 1) << shift;
+}
+
+void telemetry_record(telemetry* t, telemetry_phase phase, uint64_t ns) {
+        telemetry_histogram* h = &t->phases[phase];
+        ++h->counts[bucket(ns)];
+        ++h->n;
+        h->sum += ns;
+        if (ns < h->min) {
+                h->min = ns;
+        }
+        if (ns > h->max) {
+                h->max = ns;
+        }
+
+        // the present is part of the render; unsigned wrap-around cancels
+        // out once the render is added
+        if (phase == TELEMETRY_UPDATE) {
+                t->frame_ns += ns;
+        } else if (phase == TELEMETRY_PRESENT) {
+                t->frame_ns -= ns;
+        } else if (phase == TELEMETRY_RENDER) {
+                t->frame_ns += ns;
+                t->recent[t->recent_next] = t->frame_ns;
+                t->recent_next = (t->recent_next + 1) % TELEMETRY_RECENT;
+                t->frame_ns = 0;
+                ++t->presents;
+        }
+}
+
+// Takes the machine's counters since the last sample into the totals. Call
+// after every update. Returns 1 when a window has ended and the rates have
+// been refreshed.
+int telemetry_sample(telemetry* t, machine const* m) {
+        // the counters only grow: loading a state or rewinding runs nothing
+        // and leaves them where they are
+        t->instructions += m->instructions - t->last_instructions;
+        t->cycles += m->cycles - t->last_cycles;
+        t->frames += m->vblanks - t->last_vblanks;
+        t->last_instructions = m->instructions;
+        t->last_cycles = m->cycles;
+        t->last_vblanks = m->vblanks;
+
+        uint64_t now = telemetry_now_ns();
+        if (now - t->window_ns < TELEMETRY_WINDOW_NS) {
+                return 0;
+        }
+        double s = (now - t->window_ns) / 1e9;
+        t->mips = (t->instructions - t->window_instructions) / s / 1e6;
+        t->emulated_fps = (t->frames - t->window_frames) / s;
+        t->fps = (t->presents - t->window_presents) / s;
+        t->window_ns = now;
+        t->window_instructions = t->instructions;
+        t->window_frames = t->frames;
+        t->window_presents = t->presents;
+        return 1;
+}
+
+// Upper bound of the bucket holding the p quantile, 0 <= p <= 1.
+uint64_t telemetry_percentile(telemetry_histogram const* h, double p) {
+        if (!h->n) {
+                return 0;
+        }
+        uint64_t rank = (h->n - 1) * p;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < TELEMETRY_BUCKETS; ++b) {
+                seen += h->counts[b];
+                if (seen > rank) {
+                        uint64_t limit = bucket_limit(b) - 1;
+                        return limit < h->max ? limit : h->max;
+                }
+        }
+        return h->max;
+}
+
+static void write_histogram(FILE* f, telemetry_histogram const* h) {
+        fprintf(f,
+                "{\"count\": %llu, \"mean_ns\": %llu, \"min_ns\": %llu, "
+                "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, "
+                "\"p999_ns\": %llu, \"max_ns\": %llu, \"buckets\": [",
+                (unsigned long long)h->n,
+                (unsigned long long)(h->n ? h->sum / h->n : 0),
+                (unsigned long long)(h->n ? h->min : 0),
+                (unsigned long long)telemetry_percentile(h, 0.5),
+                (unsigned long long)telemetry_percentile(h, 0.9),
+                (unsigned long long)telemetry_percentile(h, 0.99),
+                (unsigned long long)telemetry_percentile(h, 0.999),
+                (unsigned long long)h->max);
+        // non-empty buckets only, as [upper bound in ns, count]
+        char const* sep = "";
+        for (size_t b = 0; b < TELEMETRY_BUCKETS; ++b) {
+                if (h->counts[b]) {
+                        fprintf(f, "%s[%llu, %llu]", sep,
+                                (unsigned long long)(bucket_limit(b) - 1),
+                                (unsigned long long)h->counts[b]);
+                        sep = ", ";
+                }
+        }
+        fprintf(f, "]}");
+}
+
+// Writes the totals, the overall rates and every phase histogram as JSON.
+int telemetry_write(telemetry const* t, char const* path) {
+        FILE* f = fopen(path, "w");
+        if (!f) {
+                fprintf(stderr, "Failed to open telemetry file: %s\n", path);
+                return 1;
+        }
+
+        double s = (telemetry_now_ns() - t->start_ns) / 1e9;
+        fprintf(f,
+                "{\n  \"seconds\": %.3f,\n  \"instructions\": %llu,\n"
+                "  \"cycles\": %llu,\n  \"frames\": %llu,\n"
+                "  \"presents\": %llu,\n  \"mips\": %.3f,\n"
+                "  \"emulated_fps\": %.2f,\n  \"fps\": %.2f,\n"
+                "  \"phases\": {",
+                s, (unsigned long long)t->instructions,
+                (unsigned long long)t->cycles, (unsigned long long)t->frames,
+                (unsigned long long)t->presents,
+                s > 0 ? t->instructions / s / 1e6 : 0.0,
+                s > 0 ? t->frames / s : 0.0, s > 0 ? t->presents / s : 0.0);
+        for (int p = 0; p < TELEMETRY_PHASES; ++p) {
+                fprintf(f, "%s\n    \"%s\": ", p ? "," : "", phase_names[p]);
+                write_histogram(f, &t->phases[p]);
+        }
+        fprintf(f, "\n  }\n}\n");
+
+        if (fclose(f)) {
+                fprintf(stderr, "Failed to write telemetry file: %s\n", path);
+                return 1;
+        }
+        return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "machine.h"
+
+// Frame-time telemetry: nanosecond timings of every phase of the frontend
+// loop in HDR histograms, plus emulated instructions per second and frames
+// per second over the last TELEMETRY_WINDOW_NS.
+//
+// The histograms are log-linear: exact below 2 * TELEMETRY_SUB_BUCKETS ns,
+// then TELEMETRY_SUB_BUCKETS buckets per power of two, i.e. within about 3%
+// of the true value, up to 2^40 ns. Recording a value is a count leading
+// zeros and an increment.
+#define TELEMETRY_SUB_BITS 5
+#define TELEMETRY_SUB_BUCKETS (1 << TELEMETRY_SUB_BITS)
+#define TELEMETRY_MAX_BITS 40
+#define TELEMETRY_BUCKETS \
+        (2 * TELEMETRY_SUB_BUCKETS + \
+         (TELEMETRY_MAX_BITS - TELEMETRY_SUB_BITS - 1) * TELEMETRY_SUB_BUCKETS)
+#define TELEMETRY_WINDOW_NS 1000000000ull
+#define TELEMETRY_RECENT 128
+
+typedef enum {
+        TELEMETRY_POLL,      // input events
+        TELEMETRY_EMULATE,   // cpu emulation, excluding audio
+        TELEMETRY_AUDIO,     // sound calls made by the machine
+        TELEMETRY_CONVERT,   // video ram to draw calls
+        TELEMETRY_PRESENT,   // handing the frame to the display
+        TELEMETRY_UPDATE,    // all of invaders_update
+        TELEMETRY_RENDER,    // all of invaders_render
+        TELEMETRY_PHASES
+} telemetry_phase;
+
+typedef struct {
+        uint64_t counts[TELEMETRY_BUCKETS];
+        uint64_t n;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+} telemetry_histogram;
+
+typedef struct {
+        telemetry_histogram phases[TELEMETRY_PHASES];
+        uint64_t start_ns;
+
+        // totals since the start and at the beginning of the current window
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t frames;
+        uint64_t presents;
+        uint64_t window_ns;
+        uint64_t window_instructions;
+        uint64_t window_frames;
+        uint64_t window_presents;
+
+        // rates over the last complete window
+        double mips;
+        double fps;
+        double emulated_fps;
+
+        // the machine counters at the last sample
+        uint64_t last_instructions;
+        uint64_t last_cycles;
+        size_t last_vblanks;
+
+        // busy time (updates plus render, less the present, which may wait
+        // for vsync) of the latest presents, oldest first at recent_next
+        uint64_t recent[TELEMETRY_RECENT];
+        size_t recent_next;
+        uint64_t frame_ns;
+} telemetry;
+
+void telemetry_init(telemetry* t);
+uint64_t telemetry_now_ns();
+
+void telemetry_record(telemetry* t, telemetry_phase phase, uint64_t ns);
+int telemetry_sample(telemetry* t, machine const* m);
+uint64_t telemetry_percentile(telemetry_histogram const* h, double p);
+int telemetry_write(telemetry const* t, char const* path);
+
+#endif
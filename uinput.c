@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <glob.h>
+#include <linux/uinput.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+// A virtual keyboard for trying out evdev configs (see evdev.h) without
+// hardware: creates a uinput device, prints its /dev/input path and plays a
+// script of key events on it, one `<delay ms> <code> <1|0>` line per press
+// or release. The device accepts every code the script uses; readers only
+// see it once they have opened it, so the first delay should leave time for
+// the emulator to start.
+//
+//     uinput SCRIPT|-
+
+#define UINPUT_MAX_STEPS 4096
+
+typedef struct {
+        uint32_t delay_ms;
+        uint16_t code;
+        uint8_t value;
+} step;
+
+static size_t load(FILE* f, step* steps) {
+        size_t n = 0;
+        char line[256] = "";
+        while (fgets(line, sizeof(line), f)) {
+                char* hash = strchr(line, '#');
+                if (hash) {
+                        *hash = 0;
+                }
+                unsigned long delay = 0;
+                long code = 0;
+                unsigned value = 0;
+                int fields = sscanf(line, "%lu %li %u", &delay, &code, &value);
+                if (fields <= 0) {
+                        continue;
+                }
+                if (fields != 3 || code < 0 || code >= KEY_CNT || value > 1) {
+                        fprintf(stderr, "Bad script line: %s", line);
+                        return 0;
+                }
+                if (n == UINPUT_MAX_STEPS) {
+                        fprintf(stderr, "Script too long\n");
+                        return 0;
+                }
+                steps[n++] = (step){.delay_ms = delay,
+                                    .code = code,
+                                    .value = value};
+        }
+        return n;
+}
+
+static int emit(int fd, uint16_t type, uint16_t code, int32_t value) {
+        struct input_event ie = {.type = type, .code = code, .value = value};
+        return write(fd, &ie, sizeof(ie)) != sizeof(ie);
+}
+
+// The event node the kernel made for the device, for a `device` line.
+static void print_node(int fd) {
+        char name[64] = "";
+        if (ioctl(fd, UI_GET_SYSNAME(sizeof(name)), name) < 0) {
+                return;
+        }
+        char pattern[128];
+        snprintf(pattern, sizeof(pattern),
+                 "/sys/devices/virtual/input/%s/event*", name);
+        glob_t g;
+        if (!glob(pattern, 0, 0, &g)) {
+                char const* node = strrchr(g.gl_pathv[0], '/') + 1;
+                printf("device /dev/input/%s\n", node);
+                globfree(&g);
+        }
+        fflush(stdout);
+}
+
+int main(int argc, char* argv[static argc + 1]) {
+        if (argc < 2) {
+                fprintf(stderr, "usage: %s SCRIPT|-\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+        FILE* f = strcmp(argv[1], "-") ? fopen(argv[1], "r") : stdin;
+        if (!f) {
+                fprintf(stderr, "Failed to open script: %s\n", argv[1]);
+                return EXIT_FAILURE;
+        }
+        static step steps[UINPUT_MAX_STEPS];
+        size_t n = load(f, steps);
+        if (f != stdin) {
+                fclose(f);
+        }
+        if (!n) {
+                fprintf(stderr, "Script has no events\n");
+                return EXIT_FAILURE;
+        }
+
+        int fd = open("/dev/uinput", O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+                fprintf(stderr, "Failed to open /dev/uinput\n");
+                return EXIT_FAILURE;
+        }
+        struct uinput_setup setup = {
+            .id = {.bustype = BUS_VIRTUAL, .vendor = 0x1209, .product = 1},
+            .name = "invaders uinput",
+        };
+        int err = ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0;
+        for (size_t i = 0; i < n && !err; ++i) {
+                err = ioctl(fd, UI_SET_KEYBIT, steps[i].code) < 0;
+        }
+        if (err || ioctl(fd, UI_DEV_SETUP, &setup) < 0 ||
+            ioctl(fd, UI_DEV_CREATE) < 0) {
+                fprintf(stderr, "Failed to create uinput device\n");
+                close(fd);
+                return EXIT_FAILURE;
+        }
+        print_node(fd);
+
+        for (size_t i = 0; i < n && !err; ++i) {
+                struct timespec delay = {
+                    .tv_sec = steps[i].delay_ms / 1000,
+                    .tv_nsec = steps[i].delay_ms % 1000 * 1000000L,
+                };
+                nanosleep(&delay, 0);
+                err = emit(fd, EV_KEY, steps[i].code, steps[i].value) ||
+                      emit(fd, EV_SYN, SYN_REPORT, 0);
+        }
+        if (err) {
+                fprintf(stderr, "Failed to write to uinput device\n");
+        }
+
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+        return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
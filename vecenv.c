@@ -0,0 +1,233 @@
+#include "vecenv.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "env.h"
+#include "obs.h"
+
+// Steps (or, without actions, resets) environments [begin, end).
+static int run_share(vecenv* v, size_t begin, size_t end) {
+        int err = 0;
+        for (size_t i = begin; i < end; ++i) {
+                env* e = v->envs[i];
+                env_result res = {0};
+                int reset = !v->actions;
+                if (reset) {
+                        err |= env_reset(e, &res);
+                } else if (env_step(e, v->actions[i], v->frameskip, &res)) {
+                        err = 1;
+                        continue;
+                } else {
+                        v->rewards[i] = res.reward;
+                        v->dones[i] = res.done;
+                        if (res.done) {
+                                err |= env_reset(e, &res);
+                                reset = 1;
+                        }
+                }
+                if (!res.obs) {
+                        continue;
+                }
+
+                uint8_t* obs = v->obs + i * v->obs_size;
+                obs_stack* stack = v->stacks ? v->stacks[i] : 0;
+                if (!stack) {
+                        obs_screen(res.obs, obs);
+                        continue;
+                }
+                if (reset) {
+                        obs_stack_fill(stack, res.obs);
+                } else {
+                        obs_stack_push(stack, res.obs, res.prev_obs);
+                }
+                obs_stack_read(stack, obs);
+        }
+        return err;
+}
+
+static void* worker_main(void* arg) {
+        vecenv_worker* w = arg;
+        vecenv* v = w->v;
+        size_t seen = 0;
+        for (;;) {
+                pthread_mutex_lock(&v->lock);
+                while (v->generation == seen && !v->quit) {
+                        pthread_cond_wait(&v->work, &v->lock);
+                }
+                if (v->quit) {
+                        pthread_mutex_unlock(&v->lock);
+                        return 0;
+                }
+                seen = v->generation;
+                pthread_mutex_unlock(&v->lock);
+
+                int err = run_share(v, w->begin, w->end);
+
+                pthread_mutex_lock(&v->lock);
+                v->err |= err;
+                if (!--v->pending) {
+                        pthread_cond_signal(&v->idle);
+                }
+                pthread_mutex_unlock(&v->lock);
+        }
+}
+
+// Runs every share, the calling thread takes the first one.
+static int dispatch(vecenv* v) {
+        pthread_mutex_lock(&v->lock);
+        v->err = 0;
+        v->pending = v->nworkers - 1;
+        ++v->generation;
+        pthread_cond_broadcast(&v->work);
+        pthread_mutex_unlock(&v->lock);
+
+        int err = run_share(v, v->workers[0].begin, v->workers[0].end);
+
+        pthread_mutex_lock(&v->lock);
+        while (v->pending) {
+                pthread_cond_wait(&v->idle, &v->lock);
+        }
+        err |= v->err;
+        pthread_mutex_unlock(&v->lock);
+        return err;
+}
+
+vecenv* vecenv_new(rom const* r, size_t k, size_t nthreads) {
+        if (!k) {
+                return 0;
+        }
+        if (!nthreads) {
+                nthreads = 1;
+        }
+        if (nthreads > k) {
+                nthreads = k;
+        }
+
+        vecenv* v = malloc(sizeof(vecenv));
+        if (!v) {
+                return 0;
+        }
+        *v = (vecenv){
+            .k = k,
+            .envs = calloc(k, sizeof(env*)),
+            .obs_size = OBS_HEIGHT * OBS_WIDTH,
+            .workers = calloc(nthreads, sizeof(vecenv_worker)),
+        };
+        pthread_mutex_init(&v->lock, 0);
+        pthread_cond_init(&v->work, 0);
+        pthread_cond_init(&v->idle, 0);
+        if (!v->envs || !v->workers) {
+                vecenv_delete(v);
+                return 0;
+        }
+
+        // boot the first environment, every other one starts from its state
+        env_result res;
+        for (size_t i = 0; i < k; ++i) {
+                v->envs[i] = env_new(r);
+                if (!v->envs[i] ||
+                    (i == 0 ? env_reset(v->envs[0], &res)
+                            : env_share_start(v->envs[i], v->envs[0]))) {
+                        vecenv_delete(v);
+                        return 0;
+                }
+        }
+
+        for (size_t i = 0; i < nthreads; ++i) {
+                vecenv_worker* w = &v->workers[i];
+                *w = (vecenv_worker){
+                    .v = v,
+                    .begin = i * k / nthreads,
+                    .end = (i + 1) * k / nthreads,
+                };
+                if (i && pthread_create(&w->thread, 0, worker_main, w)) {
+                        fprintf(stderr, "Failed to start vecenv thread\n");
+                        vecenv_delete(v);
+                        return 0;
+                }
+                v->nworkers = i + 1;
+        }
+
+        return v;
+}
+
+void vecenv_delete(vecenv* v) {
+        if (!v) {
+                return;
+        }
+
+        pthread_mutex_lock(&v->lock);
+        v->quit = 1;
+        pthread_cond_broadcast(&v->work);
+        pthread_mutex_unlock(&v->lock);
+        for (size_t i = 1; i < v->nworkers; ++i) {
+                pthread_join(v->workers[i].thread, 0);
+        }
+        pthread_mutex_destroy(&v->lock);
+        pthread_cond_destroy(&v->work);
+        pthread_cond_destroy(&v->idle);
+
+        for (size_t i = 0; i < v->k; ++i) {
+                if (v->envs) {
+                        env_delete(v->envs[i]);
+                }
+                if (v->stacks) {
+                        obs_stack_delete(v->stacks[i]);
+                }
+        }
+        free(v->envs);
+        free(v->stacks);
+        free(v->workers);
+        free(v);
+}
+
+// Switches every environment to stacks of depth downscaled width x height
+// frames. Takes effect with the next vecenv_reset.
+int vecenv_set_obs(vecenv* v, size_t width, size_t height, size_t depth,
+                   int maxpool) {
+        obs_stack** stacks = calloc(v->k, sizeof(obs_stack*));
+        if (!stacks) {
+                return 1;
+        }
+        for (size_t i = 0; i < v->k; ++i) {
+                stacks[i] = obs_stack_new(width, height, depth, maxpool);
+                if (!stacks[i]) {
+                        for (size_t j = 0; j < i; ++j) {
+                                obs_stack_delete(stacks[j]);
+                        }
+                        free(stacks);
+                        return 1;
+                }
+        }
+
+        if (v->stacks) {
+                for (size_t i = 0; i < v->k; ++i) {
+                        obs_stack_delete(v->stacks[i]);
+                }
+                free(v->stacks);
+        }
+        v->stacks = stacks;
+        v->obs_size = obs_stack_size(stacks[0]);
+        return 0;
+}
+
+size_t vecenv_obs_size(vecenv const* v) { return v->obs_size; }
+
+int vecenv_reset(vecenv* v, uint8_t* obs) {
+        v->actions = 0;
+        v->obs = obs;
+        return dispatch(v);
+}
+
+int vecenv_step(vecenv* v, env_action const* actions, size_t frameskip,
+                uint8_t* obs, int* rewards, uint8_t* dones) {
+        v->actions = actions;
+        v->frameskip = frameskip;
+        v->obs = obs;
+        v->rewards = rewards;
+        v->dones = dones;
+        return dispatch(v);
+}
@@ -0,0 +1,62 @@
+#ifndef VECENV_H
+#define VECENV_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "env.h"
+#include "obs.h"
+#include "rom.h"
+
+// K environments stepped together. Observations are written into one
+// caller-owned buffer of K observations of vecenv_obs_size bytes each:
+// the OBS_HEIGHT x OBS_WIDTH screen by default, or a depth x height x width
+// stack of downscaled frames after vecenv_set_obs. Rewards and dones go
+// into K-element arrays, so a step is one hand-off of three buffers and
+// nothing is allocated per step. Environments are split across a fixed set
+// of threads (the calling thread takes the first share), and finished
+// episodes are reset right away: their observation is the first one of the
+// next episode and their done flag is set for that step.
+typedef struct vecenv vecenv;
+
+typedef struct {
+        vecenv* v;
+        pthread_t thread;
+        size_t begin;
+        size_t end;
+} vecenv_worker;
+
+struct vecenv {
+        size_t k;
+        env** envs;
+        obs_stack** stacks;
+        size_t obs_size;
+
+        size_t nworkers;
+        vecenv_worker* workers;
+        pthread_mutex_t lock;
+        pthread_cond_t work;
+        pthread_cond_t idle;
+        size_t generation;
+        size_t pending;
+        int quit;
+
+        env_action const* actions;
+        size_t frameskip;
+        uint8_t* obs;
+        int* rewards;
+        uint8_t* dones;
+        int err;
+};
+
+vecenv* vecenv_new(rom const* r, size_t k, size_t nthreads);
+void vecenv_delete(vecenv* v);
+int vecenv_set_obs(vecenv* v, size_t width, size_t height, size_t depth,
+                   int maxpool);
+size_t vecenv_obs_size(vecenv const* v);
+int vecenv_reset(vecenv* v, uint8_t* obs);
+int vecenv_step(vecenv* v, env_action const* actions, size_t frameskip,
+                uint8_t* obs, int* rewards, uint8_t* dones);
+
+#endif